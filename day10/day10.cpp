@@ -10,6 +10,8 @@
 #include <ranges>
 #include <array>
 #include <list>
+#include <bit>
+#include <cstdint>
 
 struct Pos {
   int row{};
@@ -27,7 +29,59 @@ constexpr Pos east{0, 1};
 constexpr Pos south{1, 0};
 constexpr Pos west{0, -1};
 constexpr std::array cardinals{north, east, south, west};
-const std::map<char, std::vector<Pos>> directions{{'S', {north, east, south, west}}, {'|', {north, south}}, {'-', {east, west}}, {'L', {north, east}}, {'J', {north, west}}, {'7', {south, west}}, {'F', {south, east}}};
+
+// Bit i is set if the tile connects towards cardinals[i]
+constexpr std::array<uint8_t, 256> connections = [] {
+  std::array<uint8_t, 256> result{};
+  result['S'] = 0b1111;
+  result['|'] = 0b0101;
+  result['-'] = 0b1010;
+  result['L'] = 0b0011;
+  result['J'] = 0b1001;
+  result['7'] = 0b1100;
+  result['F'] = 0b0110;
+  return result;
+}();
+
+constexpr unsigned opposite(unsigned direction) {
+  return (direction + 2) % cardinals.size();
+}
+
+class Path {
+public:
+  Path() = default;
+  Path(size_t rows, size_t cols) : rows(rows), cols(cols), bits((rows * cols + 63) / 64) {
+  }
+
+  // Positions outside the grid are never on the path
+  bool contains(const Pos& p) const {
+    if (p.row < 0 || p.col < 0 || std::cmp_greater_equal(p.row, rows) || std::cmp_greater_equal(p.col, cols)) {
+      return false;
+    }
+    const auto i = index(p);
+    return bits[i / 64] >> (i % 64) & 1;
+  }
+
+  void insert(const Pos& p) {
+    const auto i = index(p);
+    count += !(bits[i / 64] >> (i % 64) & 1);
+    bits[i / 64] |= uint64_t{1} << (i % 64);
+  }
+
+  size_t size() const {
+    return count;
+  }
+
+private:
+  size_t rows{};
+  size_t cols{};
+  std::vector<uint64_t> bits{};
+  size_t count{};
+
+  size_t index(const Pos& p) const {
+    return p.row * cols + p.col;
+  }
+};
 
 class Squeeze {
 public:
@@ -71,13 +125,13 @@ class Grid {
 friend std::istream& operator>>(std::istream& is, Grid& grid);
 using Cache = std::map<Pos, bool>;
 public:
-  std::set<Pos> findPath() const {
-    for (const auto& direction : directions.at('S')) {
-      const auto current = start + direction;
-      if (!inside(current) || at(current) == '.' || !isConnected(start, current)) {
+  Path findPath() const {
+    for (unsigned direction = 0; direction < cardinals.size(); direction++) {
+      const auto current = start + cardinals[direction];
+      if (!inside(current) || !(connection(current) >> opposite(direction) & 1)) {
         continue;
       }
-      return findPath(current);
+      return findPath(current, direction);
     }
     assert(false);
   }
@@ -105,18 +159,21 @@ private:
     return grid[pos.row][pos.col];
   }
 
+  uint8_t connection(const Pos& pos) const {
+    return connections[static_cast<unsigned char>(at(pos))];
+  }
+
+  // Only valid for adjacent positions
   bool isConnected(const Pos& p1, const Pos& p2) const {
-    const auto leadsTo = [this](const Pos& from, const Pos& to) {
-      return std::ranges::any_of(directions.at(at(from)) | std::views::transform([&from](const auto& d) { return from + d; }), [&to](const auto& p) { return p == to; });
-    };
-    return leadsTo(p1, p2) && leadsTo(p2, p1);
+    const auto direction = std::ranges::find(cardinals, Pos{p2.row - p1.row, p2.col - p1.col}) - cardinals.begin();
+    return (connection(p1) >> direction & 1) && (connection(p2) >> opposite(direction) & 1);
   }
 
-  bool isSqueeze(const std::set<Pos>& path, const Pos& p1, const Pos& p2) const {
+  bool isSqueeze(const Path& path, const Pos& p1, const Pos& p2) const {
     return path.contains(p1) && path.contains(p2) && !isConnected(p1, p2);
   }
 
-  std::set<Pos> squeezing(const std::set<Pos>& path, const Pos& current) const {
+  std::set<Pos> squeezing(const Path& path, const Pos& current) const {
     std::set<Pos> result{};
     std::set<Squeeze> found{};
     std::list<Squeeze> list{};
@@ -150,27 +207,29 @@ private:
     return result;
   }
 
-  std::set<Pos> findPath(Pos current) const {
-    std::set<Pos> result{start, current};
-    auto prev = start;
-    while (inside(current) && at(current) != '.') {
-      for (const auto& direction : directions.at(at(current))) {
-        const auto next = current + direction;
-        if (next != prev) {
-          prev = current;
-          current = next;
-          result.insert(current);
-          break;
-        }
+  // An empty path when the pipes do not lead back to the start
+  Path findPath(Pos current, unsigned direction) const {
+    const Path none(grid.size(), grid.front().size());
+    Path result = none;
+    result.insert(start);
+    result.insert(current);
+    while (current != start) {
+      const auto back = opposite(direction);
+      const auto connected = connection(current);
+      if (!(connected >> back & 1)) {
+        return none;
       }
-      if (current == start) {
-        return result;
+      direction = std::countr_zero(static_cast<uint8_t>(connected & ~(1u << back)));
+      current = current + cardinals[direction];
+      if (!inside(current)) {
+        return none;
       }
+      result.insert(current);
     }
-    return {};
+    return result;
   }
 
-  void enclosed(Cache& cache, const std::set<Pos>& path, Pos pos) const {
+  void enclosed(Cache& cache, const Path& path, Pos pos) const {
     constexpr auto fill = [](Cache& cache, const std::set<Pos>& positions, bool value) {
       for (const auto& p : positions) {
         cache[p] = value;
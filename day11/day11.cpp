@@ -2,16 +2,19 @@
 #include <format>
 #include <vector>
 #include <string>
-#include <algorithm>
-#include <ranges>
 #include <cstdint>
 
-struct Pos {
-  uint64_t row{};
-  uint64_t col{};
+// Sum of all pairwise galaxy distances, which is affine in the expansion factor
+struct Lengths {
+  uint64_t base{};
+  uint64_t expanded{};
 
-  uint64_t distance(const Pos& other) const {
-    return std::max(row, other.row) - std::min(row, other.row) + std::max(col, other.col) - std::min(col, other.col);
+  uint64_t at(uint64_t expansion) const {
+    return base + expanded * (expansion - 1);
+  }
+
+  Lengths operator+(const Lengths& other) const {
+    return {base + other.base, expanded + other.expanded};
   }
 };
 
@@ -19,48 +22,54 @@ class Grid {
 friend std::istream& operator>>(std::istream& is, Grid& grid);
 public:
   uint64_t lengths(uint64_t expansion) const {
-    constexpr auto isRowEmpty = [](const auto& grid, unsigned row) {
-      return std::ranges::all_of(grid[row], [](const auto c) { return c == '.'; });
-    };
-    constexpr auto isColEmpty = [](const auto& grid, unsigned col) -> bool {
-      for (size_t row = 0; row < grid.size(); row++) {
-        if (grid[row][col] != '.')
-          return false;
-      }
-      return true;
-    };
+    return lengths().at(expansion);
+  }
 
-    std::vector<Pos> galaxies{};
-    std::vector<uint64_t> emptyRows{};
-    std::vector<uint64_t> emptyCols{};
-    for (size_t row = 0; row < grid.size(); row++) {
-      if (isRowEmpty(grid, row)) {
-        emptyRows.push_back(row);
-      }
-    }
-    for (size_t col = 0; col < grid.front().size(); col++) {
-      if (isColEmpty(grid, col)) {
-        emptyCols.push_back(col);
-      }
+  std::vector<uint64_t> lengths(const std::vector<uint64_t>& expansions) const {
+    const auto total = lengths();
+    std::vector<uint64_t> result{};
+    for (const auto expansion : expansions) {
+      result.push_back(total.at(expansion));
     }
+    return result;
+  }
+
+  // Manhattan distance separates per axis, so each axis is summed on its own from the galaxy count per row/col
+  Lengths lengths() const {
+    std::vector<uint64_t> rows(grid.size());
+    std::vector<uint64_t> cols(grid.empty() ? 0 : grid.front().size());
     for (size_t row = 0; row < grid.size(); row++) {
       for (size_t col = 0; col < grid[row].size(); col++) {
         if (grid[row][col] == '#') {
-          galaxies.push_back({row + std::ranges::count_if(emptyRows, [row](const auto i) { return i < row; }) * (expansion - 1), col + std::ranges::count_if(emptyCols, [col](const auto i) { return i < col; }) * (expansion - 1)});
+          rows[row]++;
+          cols[col]++;
         }
       }
     }
+    return axis(rows) + axis(cols);
+  }
+private:
+  std::vector<std::vector<char>> grid{};
 
-    uint64_t length{};
-    for (size_t i = 0; i < galaxies.size(); i++) {
-      for (size_t j = i + 1; j < galaxies.size(); j++) {
-        length += galaxies[i].distance(galaxies[j]);
+  static Lengths axis(const std::vector<uint64_t>& counts) {
+    Lengths result{};
+    uint64_t seen{};
+    uint64_t empty{};
+    uint64_t positionSum{};
+    uint64_t emptySum{};
+    for (uint64_t i = 0; i < counts.size(); i++) {
+      if (counts[i] == 0) {
+        empty++;
+        continue;
       }
+      result.base += counts[i] * (seen * i - positionSum);
+      result.expanded += counts[i] * (seen * empty - emptySum);
+      seen += counts[i];
+      positionSum += counts[i] * i;
+      emptySum += counts[i] * empty;
     }
-    return length;
+    return result;
   }
-private:
-  std::vector<std::vector<char>> grid{};
 };
 
 std::istream& operator>>(std::istream& is, Grid& grid) {
@@ -77,7 +86,8 @@ std::istream& operator>>(std::istream& is, Grid& grid) {
 int main() {
   Grid grid{};
   std::cin >> grid;
-  std::cout << std::format("Part 1 result = {}\n", grid.lengths(2));
-  std::cout << std::format("Part 2 result = {}\n", grid.lengths(1'000'000));
+  const auto result = grid.lengths({2, 1'000'000});
+  std::cout << std::format("Part 1 result = {}\n", result[0]);
+  std::cout << std::format("Part 2 result = {}\n", result[1]);
   return 0;
 }
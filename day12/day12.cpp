@@ -2,28 +2,174 @@
 #include <format>
 #include <vector>
 #include <string>
-#include <map>
-#include <utility>
+#include <thread>
+#include <atomic>
 #include <cstdint>
 #include <algorithm>
-#include <ranges>
+#include <cstdlib>
+#include <tuple>
+#include <optional>
+#include <bit>
 
-using Cache = std::map<std::pair<uint64_t, uint64_t>, uint64_t>;
+// Counts are kept modulo 2^64 so that large unfold factors wrap instead of overflowing
+using Matrix = std::vector<std::vector<uint64_t>>;
+
+Matrix operator*(const Matrix& left, const Matrix& right) {
+  Matrix result(left.size(), std::vector<uint64_t>(right.front().size()));
+  for (size_t i = 0; i < left.size(); i++) {
+    for (size_t k = 0; k < right.size(); k++) {
+      if (left[i][k] == 0) {
+        continue;
+      }
+      for (size_t j = 0; j < right[k].size(); j++) {
+        result[i][j] += left[i][k] * right[k][j];
+      }
+    }
+  }
+  return result;
+}
 
 struct Line {
   std::string springs{};
   std::vector<unsigned> damaged{};
 
   uint64_t arrangements() const {
-    uint64_t count{};
-    Cache cache{};
-    arrangements(cache, 0, 0, count);
-    return count;
+    const auto size = springs.size();
+    const auto groups = damaged.size();
+
+    // run[i] is the number of consecutive springs from i that are not '.'
+    std::vector<unsigned> run(size + 1);
+    for (auto i = size; i-- > 0;) {
+      run[i] = springs[i] == '.' ? 0 : run[i + 1] + 1;
+    }
+    const auto isValid = [&](size_t index, unsigned count) {
+      return run[index] >= count && (index + count == size || springs[index + count] != '#');
+    };
+
+    // ways[i * (groups + 1) + j] is the number of arrangements of springs[i..] using damaged[j..]
+    std::vector<uint64_t> ways((size + 1) * (groups + 1));
+    const auto at = [&ways, groups](size_t springsIndex, size_t damagedIndex) -> uint64_t& {
+      return ways[springsIndex * (groups + 1) + damagedIndex];
+    };
+    at(size, groups) = 1;
+    for (auto i = size; i-- > 0;) {
+      for (size_t j = 0; j <= groups; j++) {
+        uint64_t count{};
+        if (springs[i] != '#') {
+          count += at(i + 1, j);
+        }
+        if (springs[i] != '.' && j < groups && isValid(i, damaged[j])) {
+          count += at(std::min(i + damaged[j] + 1, size), j + 1);
+        }
+        at(i, j) = count;
+      }
+    }
+    return at(0, 0);
   }
 
-  Line unfold() const {
+  // Same as unfold(copies).arrangements() modulo 2^64, but composes one '?' + springs step with
+  // fast exponentiation instead of building the unfolded line. When copies can complete different
+  // numbers of groups the drift grows with copies, and stepping one copy at a time is cheaper than
+  // squaring the transfer matrix. There is no result only when that would take more than maxStepped
+  std::optional<uint64_t> arrangements(uint64_t copies) const {
+    if (copies == 0) {
+      return 1;
+    }
+    if (damaged.empty()) {
+      return std::ranges::none_of(springs, [](const auto c) { return c == '#'; });
+    }
+
+    const auto automaton = Automaton(damaged);
+    const auto joined = '?' + springs;
+    const auto [first, firstLow, firstHigh] = automaton.completions(springs);
+    const auto [step, stepLow, stepHigh] = automaton.completions(joined);
+
+    // Every copy completes between low and high groups, and in total copies * damaged.size() groups
+    // must be completed, so the drift from damaged.size() per copy is bounded by how fast it can come back
+    const int64_t groups = damaged.size();
+    const int64_t up = std::max<int64_t>(0, std::max(firstHigh, stepHigh) - groups);
+    const int64_t down = std::max<int64_t>(0, groups - std::min(firstLow, stepLow));
+    int64_t drift{};
+    if (up != 0 && down != 0) {
+      // Such lines are always stepped, and this also keeps the drift from overflowing
+      if (copies > maxStepped) {
+        return {};
+      }
+      const int64_t balance = copies * down / (up + down);
+      for (const auto c : {balance, balance + 1}) {
+        drift = std::max<int64_t>(drift, std::min<int64_t>(c * up, (copies - c) * down));
+      }
+    }
+
+    const auto states = automaton.size();
+    const auto dimension = states * (2 * drift + 1);
+    // Every squaring costs dimension^3, against dimension for every copy stepped
+    const bool stepped = dimension > copies / (dimension * std::bit_width(copies));
+    if (stepped && dimension > maxStepped / copies) {
+      return {};
+    }
+    const auto index = [states, drift](int64_t d, size_t state) -> size_t {
+      return (d + drift) * states + state;
+    };
+    const auto apply = [&](const auto& completions, const std::vector<uint64_t>& vector) {
+      std::vector<uint64_t> result(dimension);
+      for (int64_t d = -drift; d <= drift; d++) {
+        for (size_t from = 0; from < states; from++) {
+          if (vector[index(d, from)] == 0) {
+            continue;
+          }
+          for (const auto& [to, completed, count] : completions[from]) {
+            if (const auto next = d + completed - groups; std::abs(next) <= drift) {
+              result[index(next, to)] += count * vector[index(d, from)];
+            }
+          }
+        }
+      }
+      return result;
+    };
+
+    std::vector<uint64_t> vector(dimension);
+    vector[index(0, Automaton::start)] = 1;
+    vector = apply(first, vector);
+    if (stepped) {
+      for (uint64_t i = 1; i < copies; i++) {
+        vector = apply(step, vector);
+      }
+      return vector[index(0, Automaton::start)] + vector[index(0, automaton.end())];
+    }
+
+    Matrix power(dimension, std::vector<uint64_t>(dimension));
+    for (int64_t d = -drift; d <= drift; d++) {
+      for (size_t from = 0; from < states; from++) {
+        for (const auto& [to, completed, count] : step[from]) {
+          if (const auto next = d + completed - groups; std::abs(next) <= drift) {
+            power[index(next, to)][index(d, from)] += count;
+          }
+        }
+      }
+    }
+    Matrix result(dimension, std::vector<uint64_t>(1));
+    for (size_t i = 0; i < dimension; i++) {
+      result[i][0] = vector[i];
+    }
+    for (auto exponent = copies - 1; exponent > 0; exponent /= 2) {
+      if (exponent % 2 == 1) {
+        result = power * result;
+      }
+      if (exponent > 1) {
+        power = power * power;
+      }
+    }
+    for (size_t i = 0; i < dimension; i++) {
+      vector[i] = result[i][0];
+    }
+    return vector[index(0, Automaton::start)] + vector[index(0, automaton.end())];
+  }
+
+  Line unfold(unsigned count = 5) const {
     Line unfolded{};
-    static constexpr unsigned count = 5;
+    unfolded.springs.reserve((springs.size() + 1) * count);
+    unfolded.damaged.reserve(damaged.size() * count);
     for (unsigned i = 0; i < count; i++) {
       unfolded.springs += springs + (i != count - 1 ? "?" : "");
       unfolded.damaged.insert(unfolded.damaged.end(), damaged.begin(), damaged.end());
@@ -31,61 +177,116 @@ struct Line {
     return unfolded;
   }
 private:
-  void arrangements(Cache& cache, unsigned springsIndex, unsigned damagedIndex, uint64_t& count) const {
-    const auto isValid = [this](unsigned index, unsigned count) -> bool {
-      if (index + count > springs.size()) {
-        return false;
-      }
-      for (unsigned i = 0; i < count; i++) {
-        if (springs[index + i] == '.') {
-          return false;
-        }
-      }
-      return index + count == springs.size() || springs[index + count] != '#';
+  static constexpr uint64_t maxStepped = uint64_t{1} << 30;
+
+  // Matches springs against the damaged groups repeated forever. Each group has a state for every
+  // number of '#' placed so far, where the last one means the group is complete and a '.' must follow
+  class Automaton {
+  public:
+    static constexpr size_t start = 0;
+
+    struct Completion {
+      size_t state{};
+      int64_t completed{};
+      uint64_t count{};
     };
 
-    if (const auto found = cache.find({springsIndex, damagedIndex}); found != cache.end()) {
-      count += found->second;
-      return;
+    explicit Automaton(const std::vector<unsigned>& damaged) : damaged(damaged) {
+      for (const auto count : damaged) {
+        offsets.push_back(states);
+        states += count + 1;
+      }
     }
 
-    if (springsIndex >= springs.size()) {
-      count += damagedIndex == damaged.size();
-      return;
+    size_t size() const {
+      return states;
     }
 
-    switch (springs[springsIndex]) {
-      case '.': {
-        uint64_t before = count;
-        arrangements(cache, springsIndex + 1, damagedIndex, count);
-        cache[{springsIndex, damagedIndex}] = count - before;
-        break;
-      }
-      case '#': {
-        if (damagedIndex == damaged.size()) {
-          return;
+    // The state after the last group has been completed
+    size_t end() const {
+      return states - 1;
+    }
+
+    // For every state, all states reachable after matching springs together with how many groups were
+    // completed on the way. Also returns the least and most groups completed from any state
+    std::tuple<std::vector<std::vector<Completion>>, int64_t, int64_t> completions(const std::string& springs) const {
+      std::vector<std::vector<Completion>> result(states);
+      int64_t low = springs.size();
+      int64_t high = 0;
+      for (size_t from = 0; from < states; from++) {
+        // counts[completed * states + state]
+        std::vector<uint64_t> counts(states * (springs.size() + 1));
+        counts[from] = 1;
+        for (const auto c : springs) {
+          std::vector<uint64_t> next(counts.size());
+          for (size_t i = 0; i < counts.size(); i++) {
+            if (counts[i] == 0) {
+              continue;
+            }
+            for (const auto spring : {'.', '#'}) {
+              if (c != '?' && c != spring) {
+                continue;
+              }
+              if (const auto [to, completed] = move(i % states, spring); to != states) {
+                next[(i / states + completed) * states + to] += counts[i];
+              }
+            }
+          }
+          counts = std::move(next);
         }
-        if (isValid(springsIndex, damaged[damagedIndex])) {
-          uint64_t before = count;
-          arrangements(cache, springsIndex + damaged[damagedIndex] + 1, damagedIndex + 1, count);
-          cache[{springsIndex, damagedIndex}] = count - before;
+        for (size_t i = 0; i < counts.size(); i++) {
+          if (counts[i] != 0) {
+            const int64_t completed = i / states;
+            result[from].push_back({i % states, completed, counts[i]});
+            low = std::min(low, completed);
+            high = std::max(high, completed);
+          }
         }
-        break;
       }
-      case '?': {
-        uint64_t before = count;
-        arrangements(cache, springsIndex + 1, damagedIndex, count); // '.'
-        if (damagedIndex < damaged.size() && isValid(springsIndex, damaged[damagedIndex])) {
-          arrangements(cache, springsIndex + damaged[damagedIndex] + 1, damagedIndex + 1, count); // '#'
-        }
-        cache[{springsIndex, damagedIndex}] = count - before;
-        break;
+      return {result, low, high};
+    }
+
+  private:
+    std::vector<unsigned> damaged{};
+    std::vector<size_t> offsets{};
+    size_t states{};
+
+    // Returns the next state and whether a group was completed, the state is size() if the spring does not fit
+    std::pair<size_t, bool> move(size_t state, char spring) const {
+      const auto group = std::ranges::upper_bound(offsets, state) - offsets.begin() - 1;
+      const auto placed = state - offsets[group];
+      if (placed == damaged[group]) {
+        return {spring == '.' ? offsets[(group + 1) % offsets.size()] : states, false};
+      } else if (spring == '#') {
+        return {state + 1, placed + 1 == damaged[group]};
+      } else {
+        return {placed == 0 ? state : states, false};
       }
     }
-  }
+  };
 };
 
-int main() {
+// One worker per core
+template <typename F>
+uint64_t sum(const std::vector<Line>& lines, const F& f) {
+  std::atomic<size_t> next{};
+  std::atomic<uint64_t> total{};
+  {
+    std::vector<std::jthread> workers{};
+    for (unsigned i = 0; i < std::max(1u, std::thread::hardware_concurrency()); i++) {
+      workers.emplace_back([&] {
+        uint64_t result{};
+        for (size_t index; (index = next++) < lines.size();) {
+          result += f(lines[index]);
+        }
+        total += result;
+      });
+    }
+  }
+  return total;
+}
+
+int main(int argc, char* argv[]) {
   constexpr auto toVector = [](const std::string& s) -> std::vector<unsigned> {
     std::vector<unsigned> result{};
     unsigned n{};
@@ -101,7 +302,23 @@ int main() {
   while (std::cin >> springs >> damaged) {
     lines.push_back({std::move(springs), toVector(damaged)});
   }
-  std::cout << std::format("Part 1 result = {}\n", std::ranges::fold_left(lines | std::views::transform([](const auto& line) { return line.arrangements(); }), 0ull, std::plus()));
-  std::cout << std::format("Part 2 result = {}\n", std::ranges::fold_left(lines | std::views::transform([](const auto& line) { return line.unfold().arrangements(); }), 0ull, std::plus()));
+  std::cout << std::format("Part 1 result = {}\n", sum(lines, [](const auto& line) { return line.arrangements(); }));
+  std::cout << std::format("Part 2 result = {}\n", sum(lines, [](const auto& line) { return line.unfold().arrangements(); }));
+  if (argc > 1) {
+    const auto copies = std::stoull(argv[1]);
+    std::atomic<bool> supported{true};
+    const auto total = sum(lines, [copies, &supported](const auto& line) {
+      const auto result = line.arrangements(copies);
+      if (!result) {
+        supported = false;
+      }
+      return result.value_or(0);
+    });
+    if (!supported) {
+      std::cerr << std::format("Unfolding {} times takes too many steps on some lines\n", copies);
+      return 1;
+    }
+    std::cout << std::format("Unfolded {} times result = {}\n", copies, total);
+  }
   return 0;
 }
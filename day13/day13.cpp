@@ -5,8 +5,13 @@
 #include <algorithm>
 #include <ranges>
 #include <cassert>
+#include <cstdint>
+#include <bit>
+#include <thread>
+#include <atomic>
 
-using Lines = std::vector<std::vector<char>>;
+// Each line is packed into bits, '#' being set, so lines can be compared a word at a time
+using Lines = std::vector<std::vector<uint64_t>>;
 
 struct ReflectionLine {
   unsigned row{};
@@ -25,12 +30,15 @@ class Grid {
 friend std::istream& operator>>(std::istream& is, Grid& grid);
 public:
   ReflectionLine reflect(unsigned count) const {
-    constexpr auto reflecting = [](const Lines& lines, unsigned index) -> unsigned {
-      unsigned count{};
-      for (unsigned i = 0; index - i < lines.size() && index + i + 1 < lines.size(); i++) {
-        count += std::ranges::count_if(std::views::zip(lines[index - i], lines[index + i + 1]), [](const auto& pair) { return std::get<0>(pair) != std::get<1>(pair); });
+    // Stops counting as soon as more than count mismatches are found
+    const auto reflecting = [count](const Lines& lines, unsigned index) -> unsigned {
+      unsigned mismatches{};
+      for (unsigned i = 0; index - i < lines.size() && index + i + 1 < lines.size() && mismatches <= count; i++) {
+        for (const auto& [left, right] : std::views::zip(lines[index - i], lines[index + i + 1])) {
+          mismatches += std::popcount(left ^ right);
+        }
       }
-      return count;
+      return mismatches;
     };
 
     for (unsigned i = 0; i < rows.size() - 1; i++) {
@@ -52,24 +60,42 @@ private:
 };
 
 std::istream& operator>>(std::istream& is, Grid& grid) {
+  constexpr auto set = [](std::vector<uint64_t>& line, unsigned index) {
+    line.resize(std::max<size_t>(line.size(), index / 64 + 1));
+    line[index / 64] |= uint64_t{1} << (index % 64);
+  };
   std::string line{};
   while (std::getline(is, line) && !line.empty()) {
-    grid.rows.push_back({});
-    for (const auto c : line) {
-      grid.rows.back().push_back(c);
+    grid.rows.push_back(std::vector<uint64_t>((line.size() + 63) / 64));
+    grid.cols.resize(line.size());
+    for (unsigned col = 0; col < line.size(); col++) {
+      if (line[col] == '#') {
+        set(grid.rows.back(), col);
+        set(grid.cols[col], grid.rows.size() - 1);
+      }
     }
   }
-  for (unsigned i = 0; i < grid.rows[0].size(); i++) {
-    grid.cols.push_back({});
-    for (unsigned j = 0; j < grid.rows.size(); j++) {
-      grid.cols.back().push_back(grid.rows[j][i]);
-    }
+  for (auto& col : grid.cols) {
+    col.resize((grid.rows.size() + 63) / 64);
   }
   return is;
 }
 
+// One worker per core
 unsigned result(const std::vector<Grid>& grids, unsigned count) {
-  return std::ranges::fold_left(grids | std::views::transform([count](const auto& grid) { return grid.reflect(count); }), ReflectionLine{0, 0}, std::plus()).combine();
+  std::vector<ReflectionLine> lines(grids.size());
+  std::atomic<size_t> next{};
+  {
+    std::vector<std::jthread> workers{};
+    for (unsigned i = 0; i < std::max(1u, std::thread::hardware_concurrency()); i++) {
+      workers.emplace_back([&] {
+        for (size_t index; (index = next++) < grids.size();) {
+          lines[index] = grids[index].reflect(count);
+        }
+      });
+    }
+  }
+  return std::ranges::fold_left(lines, ReflectionLine{0, 0}, std::plus()).combine();
 }
 
 int main() {
@@ -5,6 +5,9 @@
 #include <array>
 #include <utility>
 #include <algorithm>
+#include <cstdint>
+#include <bit>
+#include <unordered_map>
 
 struct Pos {
   int row{};
@@ -12,88 +15,239 @@ struct Pos {
   auto operator<=>(const Pos&) const = default;
 };
 
-Pos operator+(const Pos& p1, const Pos& p2) {
-  return {p1.row + p2.row, p1.col + p2.col};
-}
-
 constexpr Pos north = {-1, 0};
 constexpr Pos east = {0, 1};
 constexpr Pos south = {1, 0};
 constexpr Pos west = {0, -1};
 constexpr std::array cardinals{north, west, south, east};
 
+// One row or column of the platform packed into bits
+class Bits {
+public:
+  Bits() = default;
+  explicit Bits(size_t size) : words((size + 63) / 64) {
+  }
+
+  void set(size_t i) {
+    words[i / 64] |= uint64_t{1} << (i % 64);
+  }
+
+  unsigned count() const {
+    return count(0, words.size() * 64);
+  }
+
+  unsigned count(size_t begin, size_t end) const {
+    unsigned result{};
+    forWords(words, begin, end, [&result](const auto word, const auto mask) { result += std::popcount(word & mask); });
+    return result;
+  }
+
+  void assign(size_t begin, size_t end, bool value) {
+    forWords(words, begin, end, [value](auto& word, const auto mask) { word = value ? word | mask : word & ~mask; });
+  }
+
+  uint64_t word(size_t i) const {
+    return words[i];
+  }
+
+  uint64_t& word(size_t i) {
+    return words[i];
+  }
+
+  size_t wordCount() const {
+    return words.size();
+  }
+
+  bool operator==(const Bits&) const = default;
+
+private:
+  std::vector<uint64_t> words{};
+
+  // Calls f with each word overlapping [begin, end) and the mask of the bits in range
+  template <typename Words, typename F>
+  static void forWords(Words& words, size_t begin, size_t end, F f) {
+    while (begin < end) {
+      const auto index = begin / 64;
+      const auto low = begin % 64;
+      const auto high = std::min<size_t>(64, end - index * 64);
+      const auto mask = (high == 64 ? ~uint64_t{} : (uint64_t{1} << high) - 1) & ~((uint64_t{1} << low) - 1);
+      f(words[index], mask);
+      begin = index * 64 + high;
+    }
+  }
+};
+
+using Lines = std::vector<Bits>;
+
+// 128-bit hash of the rounded rocks, wide enough that collisions are not a practical concern
+struct Hash {
+  uint64_t low{};
+  uint64_t high{};
+  bool operator==(const Hash&) const = default;
+};
+
+struct HashHasher {
+  size_t operator()(const Hash& hash) const {
+    return hash.low;
+  }
+};
+using Segments = std::vector<std::vector<std::pair<unsigned, unsigned>>>;
+
 class Grid {
 friend std::istream& operator>>(std::istream& is, Grid& grid);
 public:
   unsigned load() const {
     unsigned result{};
-    for (unsigned row = 0; row < grid.size(); row++) {
-      for (unsigned col = 0; col < grid[row].size(); col++) {
-        if (grid[row][col] != 'O') {
-          continue;
-        }
-        result += grid.size() - row;
-      }
+    for (unsigned row = 0; row < rows.size(); row++) {
+      result += (rows.size() - row) * rows[row].count();
     }
 
     return result;
   }
 
-  Grid tilt(const Pos& direction) const {
-    auto copy = *this;
-    for (unsigned row = direction == south ? copy.grid.size() - 1 : 0; row < copy.grid.size(); row += direction == south ? -1 : 1) {
-      for (unsigned col = direction == east ? copy.grid[row].size() - 1 : 0; col < copy.grid[row].size(); col += direction == east ? -1: 1) {
-        if (copy.grid[row][col] != 'O') {
-          continue;
+  // Rounded rocks between two cube rocks all end up stacked against one of them
+  void tilt(const Pos& direction) {
+    const bool vertical = direction.row != 0;
+    auto& lines = vertical ? cols : rows;
+    const auto& segments = vertical ? colSegments : rowSegments;
+    const bool backwards = direction == south || direction == east;
+    for (unsigned i = 0; i < lines.size(); i++) {
+      for (const auto& [begin, end] : segments[i]) {
+        const auto count = lines[i].count(begin, end);
+        lines[i].assign(begin, end, false);
+        if (backwards) {
+          lines[i].assign(end - count, end, true);
+        } else {
+          lines[i].assign(begin, begin + count, true);
         }
-        auto moved = Pos(row, col);
-        for (; copy.inside(moved + direction) && copy.at(moved + direction) == '.'; moved = moved + direction)
-          ;
-        copy.grid[row][col] = '.';
-        copy.grid[moved.row][moved.col] = 'O';
       }
     }
+    if (vertical) {
+      transpose(cols, rows);
+    } else {
+      transpose(rows, cols);
+    }
+  }
 
-    return copy;
+  void spin() {
+    for (const auto& direction : cardinals) {
+      tilt(direction);
+    }
   }
 
-  unsigned cycle(const unsigned cycles) {
-    std::vector<Grid> grids{};
+  // Only the hash and load of each spin are kept. With verify, a hash hit is only trusted once
+  // spinning for the found period actually leads back to the same rocks
+  unsigned cycle(const unsigned cycles, bool verify = true) const {
+    std::unordered_map<Hash, unsigned, HashHasher> seen{};
+    std::vector<unsigned> loads{};
     Grid current = *this;
-    while (std::ranges::find(grids, current) == grids.end()) {
-      grids.push_back(current);
-      for (const auto& direction : cardinals) {
-        current = std::move(current.tilt(direction));
+    while (true) {
+      const auto hash = current.hash();
+      if (const auto found = seen.find(hash); found != seen.end() && (!verify || current.repeats(loads.size() - found->second))) {
+        const unsigned initial = found->second;
+        const unsigned period = loads.size() - initial;
+        return cycles < loads.size() ? loads[cycles] : loads[initial + (cycles - initial) % period];
       }
+      seen[hash] = loads.size();
+      loads.push_back(current.load());
+      current.spin();
     }
-    std::vector<unsigned> sequence{};
-    for (auto itr = std::ranges::find(grids, current); itr != grids.end(); ++itr) {
-      sequence.push_back(itr->load());
+  }
+
+  Hash hash() const {
+    Hash result{};
+    for (const auto& row : rows) {
+      for (size_t i = 0; i < row.wordCount(); i++) {
+        result.low = (result.low ^ row.word(i)) * 0x9E3779B97F4A7C15;
+        result.low ^= result.low >> 32;
+        result.high = std::rotl((result.high + row.word(i)) * 0xC2B2AE3D27D4EB4F, 31);
+      }
     }
-    const unsigned period = sequence.size();
-    const unsigned initial = grids.size() - period;
-    const unsigned index = cycles - (initial + period * ((cycles - initial) / period));
-    return sequence[index];
+    return result;
+  }
+
+  bool operator==(const Grid& other) const {
+    return rows == other.rows;
   }
 
-  auto operator<=>(const Grid&) const = default;
-  
 private:
-  bool inside(const Pos& p) const {
-    return p.row >= 0 && p.col >= 0 && std::cmp_less(p.row, grid.size()) && std::cmp_less(p.col, grid[p.row].size());
+  // Rounded rocks, kept both row by row and column by column
+  Lines rows{};
+  Lines cols{};
+  // The ranges between cube rocks in each row and column
+  Segments rowSegments{};
+  Segments colSegments{};
+
+  bool repeats(unsigned period) const {
+    auto copy = *this;
+    for (unsigned i = 0; i < period; i++) {
+      copy.spin();
+    }
+    return copy == *this;
   }
-  
-  char at(const Pos& p) const {
-    return grid[p.row][p.col];
+
+  static void transpose(std::array<uint64_t, 64>& block) {
+    uint64_t mask = 0x00000000FFFFFFFF;
+    for (unsigned j = 32; j != 0; j >>= 1, mask ^= mask << j) {
+      for (unsigned k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+        const auto t = ((block[k] >> j) ^ block[k | j]) & mask;
+        block[k] ^= t << j;
+        block[k | j] ^= t;
+      }
+    }
   }
 
-  std::vector<std::string> grid{};
+  static void transpose(const Lines& from, Lines& to) {
+    std::array<uint64_t, 64> block{};
+    for (size_t i = 0; i < from.size(); i += 64) {
+      for (size_t j = 0; j < to.size(); j += 64) {
+        for (size_t k = 0; k < 64; k++) {
+          block[k] = i + k < from.size() ? from[i + k].word(j / 64) : 0;
+        }
+        transpose(block);
+        for (size_t k = 0; k < 64 && j + k < to.size(); k++) {
+          to[j + k].word(i / 64) = block[k];
+        }
+      }
+    }
+  }
 };
 
 std::istream& operator>>(std::istream& is, Grid& grid) {
+  constexpr auto segments = [](const auto& isCube, unsigned size) {
+    std::vector<std::pair<unsigned, unsigned>> result{};
+    for (unsigned begin = 0, end = 0; end <= size; end++) {
+      if (end == size || isCube(end)) {
+        if (begin < end) {
+          result.push_back({begin, end});
+        }
+        begin = end + 1;
+      }
+    }
+    return result;
+  };
+
+  std::vector<std::string> lines{};
   std::string line{};
   while (is >> line) {
-    grid.grid.push_back(std::move(line));
+    lines.push_back(std::move(line));
+  }
+
+  const unsigned height = lines.size();
+  const unsigned width = lines.empty() ? 0 : lines.front().size();
+  grid.rows.assign(height, Bits(width));
+  grid.cols.assign(width, Bits(height));
+  for (unsigned row = 0; row < height; row++) {
+    for (unsigned col = 0; col < width; col++) {
+      if (lines[row][col] == 'O') {
+        grid.rows[row].set(col);
+        grid.cols[col].set(row);
+      }
+    }
+    grid.rowSegments.push_back(segments([&lines, row](unsigned col) { return lines[row][col] == '#'; }, width));
+  }
+  for (unsigned col = 0; col < width; col++) {
+    grid.colSegments.push_back(segments([&lines, col](unsigned row) { return lines[row][col] == '#'; }, height));
   }
   return is;
 }
@@ -101,7 +255,9 @@ std::istream& operator>>(std::istream& is, Grid& grid) {
 int main() {
   Grid grid{};
   std::cin >> grid;
-  std::cout << std::format("Part 1 result = {}\n", grid.tilt(north).load());
+  auto tilted = grid;
+  tilted.tilt(north);
+  std::cout << std::format("Part 1 result = {}\n", tilted.load());
   std::cout << std::format("Part 2 result = {}\n", grid.cycle(1000000000u));
   return 0;
 }
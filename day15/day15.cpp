@@ -1,67 +1,154 @@
 #include <iostream>
 #include <format>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <algorithm>
 #include <ranges>
 #include <array>
-#include <list>
+#include <unordered_map>
+#include <iterator>
+#include <charconv>
+#include <limits>
+#include <cstdint>
 #include <cassert>
 
-unsigned hash(const std::string& s) {
+unsigned hash(std::string_view s) {
   return std::ranges::fold_left(s, 0u, [](const auto a, const auto b) { return (a + b) * 17 % 256; });
 }
 
-unsigned power(const std::vector<std::string>& sequence) {
-  constexpr auto parse = [](const auto& step) -> std::tuple<std::string, char, unsigned> {
-    if (const auto split = step.find('='); split != std::string::npos) {
-      return {step.substr(0, split), step[split], std::stoi(step.substr(split + 1))};
-    } else if (const auto split = step.find('-'); split != std::string::npos) {
-      return {step.substr(0, split), step[split], 0};
+// Every step is hashed in the same pass over the sequence, without splitting it first
+unsigned hashes(std::string_view sequence) {
+  unsigned result{};
+  uint8_t current{};
+  for (const auto c : sequence) {
+    if (c == ',') {
+      result += current;
+      current = 0;
+    } else {
+      current = (current + c) * 17;
     }
-    assert(false);
-  };
+  }
+  return result + current;
+}
+
+auto steps(std::string_view sequence) {
+  return sequence | std::views::split(',') | std::views::transform([](const auto& step) { return std::string_view(step.begin(), step.end()); });
+}
+
+// Every label is interned to a slot the first time it is seen, after which steps do no allocation.
+// Each box keeps its slots in insertion order, removed lenses are left as tombstones until they
+// make up half the box
+class Boxes {
+public:
+  void insert(std::string_view label, unsigned focal) {
+    auto& lens = lenses[intern(label)];
+    lens.focal = focal;
+    if (lens.entry == absent) {
+      auto& box = boxes[lens.box];
+      lens.entry = box.order.size();
+      box.order.push_back(&lens - lenses.data());
+    }
+  }
+
+  void remove(std::string_view label) {
+    const auto found = slots.find(label);
+    if (found == slots.end() || lenses[found->second].entry == absent) {
+      return;
+    }
+    auto& lens = lenses[found->second];
+    auto& box = boxes[lens.box];
+    box.order[lens.entry] = absent;
+    lens.entry = absent;
+    if (++box.removed * 2 > box.order.size()) {
+      compact(box);
+    }
+  }
+
+  unsigned power() const {
+    unsigned result{};
+    for (unsigned i = 0; i < boxes.size(); i++) {
+      unsigned position{};
+      for (const auto slot : boxes[i].order) {
+        if (slot != absent) {
+          result += (i + 1) * ++position * lenses[slot].focal;
+        }
+      }
+    }
+    return result;
+  }
+
+private:
+  static constexpr unsigned absent = std::numeric_limits<unsigned>::max();
 
   struct Lens {
-    const std::string label{};
+    unsigned box{};
     unsigned focal{};
+    unsigned entry{absent};
+  };
+
+  struct Box {
+    std::vector<unsigned> order{};
+    unsigned removed{};
   };
 
-  std::array<std::list<Lens>, 256> boxes{};
+  struct Hasher {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const {
+      return std::hash<std::string_view>()(s);
+    }
+  };
 
-  for (const auto& step : sequence) {
-    const auto [label, op, focal] = parse(step);
-    auto& box = boxes[hash(label)];
-    switch (op) {
+  std::unordered_map<std::string, unsigned, Hasher, std::equal_to<>> slots{};
+  std::vector<Lens> lenses{};
+  std::array<Box, 256> boxes{};
+
+  unsigned intern(std::string_view label) {
+    if (const auto found = slots.find(label); found != slots.end()) {
+      return found->second;
+    }
+    slots.emplace(label, lenses.size());
+    lenses.push_back({hash(label)});
+    return lenses.size() - 1;
+  }
+
+  void compact(Box& box) {
+    std::erase(box.order, absent);
+    for (unsigned i = 0; i < box.order.size(); i++) {
+      lenses[box.order[i]].entry = i;
+    }
+    box.removed = 0;
+  }
+};
+
+unsigned power(std::string_view sequence) {
+  Boxes boxes{};
+  for (const auto step : steps(sequence)) {
+    const auto split = step.find_first_of("=-");
+    switch (step[split]) {
       case '-':
-        box.remove_if([&label](const auto& lens) { return lens.label == label; });
+        boxes.remove(step.substr(0, split));
         break;
       case '=': {
-        if (auto found = std::ranges::find_if(box, [&label](const auto& lens) { return lens.label == label; }); found != box.end()) {
-          found->focal = focal;
-        } else {
-          box.push_back({label, focal});
-        }
+        unsigned focal{};
+        std::from_chars(step.data() + split + 1, step.data() + step.size(), focal);
+        boxes.insert(step.substr(0, split), focal);
         break;
       }
       default:
         assert(false);
     }
   }
-
-  return std::ranges::fold_left(std::views::zip_transform([](const auto i, const auto& box) { return std::ranges::fold_left(std::views::zip_transform([i](const auto j, const auto& lens) { return i * j * lens.focal; }, std::views::iota(1u, box.size() + 1), box), 0u, std::plus()); }, std::views::iota(1u, boxes.size() + 1), boxes), 0u, std::plus());
+  return boxes.power();
 }
 
 int main() {
-  std::vector<std::string> sequence{};
-  std::string step{};
-  while (std::getline(std::cin, step, ',')) {
-    if (step.back() == '\n')
-      step.pop_back();
-    sequence.push_back(std::move(step));
+  std::string sequence{std::istreambuf_iterator<char>(std::cin), {}};
+  while (!sequence.empty() && sequence.back() == '\n') {
+    sequence.pop_back();
   }
 
-  std::cout << std::format("Part 1 result = {}\n", std::ranges::fold_left(sequence | std::views::transform([](const auto& s) { return hash(s); }), 0u, std::plus()));
+  std::cout << std::format("Part 1 result = {}\n", hashes(sequence));
   std::cout << std::format("Part 2 result = {}\n", power(sequence));
   return 0;
 }
@@ -1,10 +1,16 @@
 #include <iostream>
 #include <format>
 #include <vector>
-#include <list>
-#include <set>
 #include <string>
 #include <utility>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <ranges>
+#include <limits>
+#include <bit>
+#include <thread>
+#include <atomic>
 
 struct Pos {
   const int row{};
@@ -12,119 +18,289 @@ struct Pos {
   auto operator<=>(const Pos&) const = default;
 };
 
-Pos operator+(const Pos& p1, const Pos& p2) {
-  return {p1.row + p2.row, p1.col + p2.col};
-}
-
 constexpr Pos north{-1, 0};
 constexpr Pos east{0, 1};
 constexpr Pos south{1, 0};
 constexpr Pos west{0, -1};
+constexpr std::array cardinals{north, east, south, west};
 
 struct Light {
   const Pos pos{};
   const Pos dir{};
   auto operator<=>(const Light&) const = default;
+};
 
-  Light move() const {
-    return {pos + dir, dir};
-  }
-
-  Light redirect(const Pos& direction) const {
-    return {pos + direction, direction};
-  }
-
-  Light rotate(const bool clockwise) const {
-    const auto factor = clockwise ? -1 : 1;
-    const Pos direction{-dir.col * factor, dir.row * factor};
-    return {pos + direction, direction};
-  }
+// Reusable buffers so that repeated energize calls do not allocate
+struct Scratch {
+  // Bit d is set once a beam has moved through the tile in cardinals[d]
+  std::vector<uint8_t> visited{};
+  // Beams waiting to be followed, as (tile index, direction)
+  std::vector<std::pair<unsigned, unsigned>> stack{};
 };
 
 class Grid {
 friend std::istream& operator>>(std::istream& is, Grid& grid);
 public:
   unsigned energize(const Light& start) const {
-    std::set<Light> found{start};
-    std::list<Light> list{start};
-
-    while (!list.empty()) {
-      const auto light = list.front();
-      list.pop_front();
-      for (const auto& l : move(light)) {
-        if (!found.contains(l)) {
-          found.insert(l);
-          list.push_back(l);
+    Scratch scratch{};
+    return energize(start, scratch);
+  }
+
+  unsigned energize(const Light& start, Scratch& scratch) const {
+    auto& visited = scratch.visited;
+    auto& stack = scratch.stack;
+    visited.assign(tiles.size(), 0);
+    // Beams are only pushed when leaving a mirror or splitter, which happens at most twice per tile and direction
+    stack.resize(mirrors * 8 + 1);
+    size_t top{};
+    unsigned energized{};
+
+    stack[top++] = {start.pos.row * width + start.pos.col, direction(start.dir)};
+    while (top != 0) {
+      const auto [index, dir] = stack[--top];
+      const int delta = deltas[dir];
+
+      // Empty tiles are passed straight through
+      const auto length = runs[dir][index];
+      for (unsigned i = 0; i < length; i++) {
+        auto& tile = visited[index + i * delta];
+        energized += tile == 0;
+        tile |= 1 << dir;
+      }
+      if (length == remaining(index, dir)) {
+        continue;
+      }
+
+      const auto next = index + length * delta;
+      if (visited[next] >> dir & 1) {
+        continue;
+      }
+      energized += visited[next] == 0;
+      visited[next] |= 1 << dir;
+      for (unsigned out = 0; out < cardinals.size(); out++) {
+        if ((outgoing(tiles[next], dir) >> out & 1) && remaining(next, out) > 1) {
+          stack[top++] = {next + deltas[out], out};
         }
       }
     }
 
-    std::set<Pos> energized{};
-    for (const auto& l : found) {
-      energized.insert(l.pos);
-    }
-    return energized.size();
+    return energized;
   }
 
+  // Beams entering a mirror or splitter in some direction form a graph, joined by the runs of empty tiles
+  // between them. Its strongly connected components are condensed and the tiles energized from each
+  // component are computed once, so every start only has to combine its first run with one bitset
   unsigned energizeLargest() const {
-    unsigned result{};
+    std::vector<std::pair<unsigned, unsigned>> starts{};
+    for (unsigned row = 0; row < height; row++) {
+      starts.push_back({row * width, 1});
+      starts.push_back({row * width + width - 1, 3});
+    }
+    for (unsigned col = 0; col < width; col++) {
+      starts.push_back({col, 2});
+      starts.push_back({(height - 1) * width + col, 0});
+    }
+
+    std::vector<unsigned> ids(tiles.size(), none);
+    std::vector<unsigned> nodeTiles{};
+    for (unsigned i = 0; i < tiles.size(); i++) {
+      if (tiles[i] != '.') {
+        ids[i] = nodeTiles.size();
+        nodeTiles.push_back(i);
+      }
+    }
+    // Calls mark on every empty tile from index onwards in cardinals[dir], and returns the node the beam reaches
+    const auto follow = [&](unsigned index, unsigned dir, const auto& mark) -> unsigned {
+      const auto length = runs[dir][index];
+      for (unsigned i = 0; i < length; i++) {
+        mark(index + i * deltas[dir]);
+      }
+      return length == remaining(index, dir) ? none : ids[index + length * deltas[dir]] * 4 + dir;
+    };
+    // Calls f with the tile and direction of every beam leaving node
+    const auto leaving = [&](unsigned node, const auto& f) {
+      const auto tile = nodeTiles[node / 4];
+      for (unsigned out = 0; out < cardinals.size(); out++) {
+        if ((outgoing(tiles[tile], node % 4) >> out & 1) && remaining(tile, out) > 1) {
+          f(tile + deltas[out], out);
+        }
+      }
+    };
 
-    for (unsigned row = 0; row < grid.size(); row++) {
-      result = std::max(result, energize({Pos(row, 0), east}));
-      result = std::max(result, energize({Pos(row, grid[row].size() - 1), west}));
+    const auto nodes = nodeTiles.size() * 4;
+    std::vector<std::array<unsigned, 2>> successors(nodes, {none, none});
+    for (unsigned node = 0; node < nodes; node++) {
+      unsigned count{};
+      leaving(node, [&](unsigned index, unsigned dir) { successors[node][count++] = follow(index, dir, [](unsigned) {}); });
     }
 
-    for (unsigned col = 0; col < grid.front().size(); col++) {
-      result = std::max(result, energize({Pos(0, col), south}));
-      result = std::max(result, energize({Pos(grid.size() - 1, col), north}));
+    // Tarjan's algorithm emits each component after every component reachable from it
+    const auto words = (tiles.size() + 63) / 64;
+    std::vector<unsigned> order(nodes, none);
+    std::vector<unsigned> low(nodes);
+    std::vector<unsigned> components(nodes, none);
+    std::vector<std::vector<uint64_t>> energized{};
+    std::vector<unsigned> stack{};
+    std::vector<std::pair<unsigned, unsigned>> calls{};
+    unsigned counter{};
+    const auto visit = [&](unsigned node) {
+      order[node] = low[node] = counter++;
+      stack.push_back(node);
+      calls.push_back({node, 0});
+    };
+    const auto emit = [&](unsigned root) {
+      std::vector<uint64_t> bits(words);
+      const auto mark = [&bits](unsigned index) { bits[index / 64] |= uint64_t{1} << (index % 64); };
+      const auto component = energized.size();
+      std::vector<unsigned> members{};
+      do {
+        members.push_back(stack.back());
+        components[stack.back()] = component;
+        stack.pop_back();
+      } while (members.back() != root);
+      for (const auto node : members) {
+        mark(nodeTiles[node / 4]);
+        leaving(node, [&](unsigned index, unsigned dir) { follow(index, dir, mark); });
+        for (const auto next : successors[node]) {
+          if (next != none && components[next] != component) {
+            for (size_t i = 0; i < words; i++) {
+              bits[i] |= energized[components[next]][i];
+            }
+          }
+        }
+      }
+      energized.push_back(std::move(bits));
+    };
+
+    std::vector<unsigned> first{};
+    for (const auto& [index, dir] : starts) {
+      const auto node = follow(index, dir, [](unsigned) {});
+      first.push_back(node);
+      if (node == none || order[node] != none) {
+        continue;
+      }
+      visit(node);
+      while (!calls.empty()) {
+        auto& [current, next] = calls.back();
+        if (next < successors[current].size()) {
+          const auto successor = successors[current][next++];
+          if (successor == none) {
+            continue;
+          }
+          if (order[successor] == none) {
+            visit(successor);
+          } else if (components[successor] == none) {
+            low[current] = std::min(low[current], order[successor]);
+          }
+          continue;
+        }
+        const auto done = current;
+        calls.pop_back();
+        if (!calls.empty()) {
+          low[calls.back().first] = std::min(low[calls.back().first], low[done]);
+        }
+        if (low[done] == order[done]) {
+          emit(done);
+        }
+      }
+    }
+
+    // One worker per core
+    std::atomic<size_t> next{};
+    std::atomic<unsigned> result{};
+    {
+      std::vector<std::jthread> workers{};
+      for (unsigned i = 0; i < std::max(1u, std::thread::hardware_concurrency()); i++) {
+        workers.emplace_back([&] {
+          std::vector<uint64_t> bits(words);
+          for (size_t index; (index = next++) < starts.size();) {
+            const auto& [tile, dir] = starts[index];
+            if (first[index] != none) {
+              bits = energized[components[first[index]]];
+            } else {
+              std::ranges::fill(bits, 0);
+            }
+            follow(tile, dir, [&bits](unsigned i) { bits[i / 64] |= uint64_t{1} << (i % 64); });
+            const unsigned count = std::ranges::fold_left(bits | std::views::transform([](const auto word) { return std::popcount(word); }), 0u, std::plus());
+            for (auto largest = result.load(); count > largest && !result.compare_exchange_weak(largest, count);)
+              ;
+          }
+        });
+      }
     }
 
     return result;
   }
 
 private:
-  std::vector<std::string> grid{};
-  bool inside(const Light& l) const {
-    return l.pos.row >= 0 && l.pos.col >= 0 && std::cmp_less(l.pos.row, grid.size()) && std::cmp_less(l.pos.col, grid[l.pos.row].size());
-  }
+  static constexpr unsigned none = std::numeric_limits<unsigned>::max();
 
-  char at(const Light& l) const {
-    return grid[l.pos.row][l.pos.col];
+  std::string tiles{};
+  unsigned width{};
+  unsigned height{};
+  unsigned mirrors{};
+  // runs[d][i] is the number of empty tiles from i onwards in cardinals[d]
+  std::array<std::vector<unsigned>, 4> runs{};
+  std::array<int, 4> deltas{};
+
+  static unsigned direction(const Pos& dir) {
+    return std::ranges::find(cardinals, dir) - cardinals.begin();
   }
 
-  std::vector<Light> move(const Light& light) const {
-    std::vector<Light> result{};
-    const auto add = [this, &result](const auto& l) {
-      if (inside(l)) {
-        result.push_back(l);
-      }
-    };
-    if (!inside(light)) {
-      return result;
+  // The directions beams continue in after entering tile in cardinals[dir], as a bit mask
+  static uint8_t outgoing(char tile, unsigned dir) {
+    switch (tile) {
+      case '|':
+        return dir % 2 == 1 ? 0b0101 : 1 << dir;
+      case '-':
+        return dir % 2 == 0 ? 0b1010 : 1 << dir;
+      case '/':
+        return 1 << (dir ^ 1);
+      case '\\':
+        return 1 << (3 - dir);
+      default:
+        return 1 << dir;
     }
+  }
 
-    const auto c = at(light);
-    if (light.dir.col != 0 && c == '|') {
-      add(light.redirect(north));
-      add(light.redirect(south));
-    } else if (light.dir.row != 0 && c == '-') {
-      add(light.redirect(east));
-      add(light.redirect(west));
-    } else if ((c == '\\' && (light.dir == east || light.dir == west)) || (c == '/' && (light.dir == north || light.dir == south))) {
-      add(light.rotate(true));
-    } else if ((c == '\\' && (light.dir == north || light.dir == south)) || (c == '/' && (light.dir == east || light.dir == west))) {
-      add(light.rotate(false));
-    } else {
-      add(light.move());
+  // Number of tiles from index to the edge in cardinals[dir], including index
+  unsigned remaining(unsigned index, unsigned dir) const {
+    const auto row = index / width;
+    const auto col = index % width;
+    switch (dir) {
+      case 0:
+        return row + 1;
+      case 1:
+        return width - col;
+      case 2:
+        return height - row;
+      default:
+        return col + 1;
     }
-    return result;
   }
 };
 
 std::istream& operator>>(std::istream& is, Grid& grid) {
   std::string line;
   while (is >> line) {
-    grid.grid.push_back(std::move(line));
+    grid.width = line.size();
+    grid.height++;
+    grid.tiles += line;
+  }
+
+  grid.mirrors = std::ranges::count_if(grid.tiles, [](const auto c) { return c != '.'; });
+  grid.deltas = {-static_cast<int>(grid.width), 1, static_cast<int>(grid.width), -1};
+  for (unsigned dir = 0; dir < cardinals.size(); dir++) {
+    auto& run = grid.runs[dir];
+    run.assign(grid.tiles.size(), 0);
+    // Start from the edge the runs lead towards so each run extends the next one
+    const bool forwards = dir == 0 || dir == 3;
+    for (unsigned i = 0; i < grid.tiles.size(); i++) {
+      const auto index = forwards ? i : grid.tiles.size() - 1 - i;
+      if (grid.tiles[index] == '.') {
+        run[index] = 1 + (grid.remaining(index, dir) > 1 ? run[index + grid.deltas[dir]] : 0);
+      }
+    }
   }
   return is;
 }
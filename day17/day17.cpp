@@ -2,11 +2,11 @@
 #include <format>
 #include <vector>
 #include <array>
-#include <list>
 #include <limits>
 #include <utility>
-#include <cassert>
-#include <queue>
+#include <cstdint>
+#include <map>
+#include <ranges>
 
 using Direction = std::pair<int, int>;
 
@@ -14,129 +14,169 @@ constexpr Direction north{-1, 0};
 constexpr Direction east{0, 1};
 constexpr Direction south{1, 0};
 constexpr Direction west{0, -1};
-constexpr std::array cardinals{north, east, south, west};
-
-struct Node {
-  unsigned cost{};
-  bool visited{};
-  bool destination{};
-  unsigned value{std::numeric_limits<unsigned>::max()};
-  std::vector<Node*> neighbors{};
+
+// The directions a crucible can leave a block in, indexed by axis (0 horizontal, 1 vertical)
+constexpr std::array<std::array<Direction, 2>, 2> axes{{{east, west}, {north, south}}};
+
+struct Pos {
+  unsigned row{};
+  unsigned col{};
 };
 
-using Graph = std::vector<std::vector<std::vector<Node>>>;
+// How many blocks a crucible must, and may, move in a straight line before turning
+struct Rules {
+  unsigned minRun{};
+  unsigned maxRun{};
+};
+
+constexpr Rules regular{1, 3};
+constexpr Rules ultra{4, 10};
 
 class Grid {
 friend std::istream& operator>>(std::istream& is, Grid& grid);
 public:
-  unsigned path(const bool part1) {
-    auto& graph = part1 ? regular : ultra;
-
-    struct Element {
-      Node* node{};
-      unsigned value{};
-
-      Element(Node* node) : node(node), value(node->value) {}
-    };
-    constexpr auto cmp = [](const Element& e1, const Element& e2) { return e1.value > e2.value; };
-    std::priority_queue<Element, std::vector<Element>, decltype(cmp)> unvisited{};
-    for (unsigned i = 0; i < cardinals.size(); i++) {
-      at(graph, 0, 0, i, 0).value = 0;
-      unvisited.push(&at(graph, 0, 0, i, 0));
+  // A state is a block together with the axis the crucible must leave it along. Every move goes straight
+  // between minRun and maxRun blocks and then turns, so the run length never needs to be part of the state.
+  // Moves cost at most 9 per block, so Dial's algorithm with a ring of buckets replaces a binary heap.
+  // With astar the buckets are ordered by distance plus the cheapest unconstrained path to the goal, which is cached
+  // per goal, so such calls must not run concurrently on the same grid
+  unsigned path(const Rules& rules, const Pos& from, const Pos& to, const bool astar = false) const {
+    static constexpr auto infinity = std::numeric_limits<uint32_t>::max();
+    const unsigned start = from.row * width + from.col;
+    const unsigned goal = to.row * width + to.col;
+    if (start == goal) {
+      return 0;
     }
-
-    while (true) {
-      auto [node, value] = unvisited.top();
-      unvisited.pop();
-      if (node->visited) {
-        continue;
+    const std::vector<uint32_t> zero(astar ? 0 : costs.size());
+    const auto& estimates = astar ? heuristic(goal) : zero;
+
+    std::vector<uint32_t> distances(costs.size() * 2, infinity);
+    // The estimate can grow by at most the cost of moving back, so a move raises the priority by at most twice its cost
+    std::vector<std::vector<uint32_t>> buckets((astar ? 18 : 9) * rules.maxRun + 1);
+    size_t queued{};
+    const auto push = [&](uint32_t state, uint32_t distance) {
+      if (distance < distances[state] && estimates[state / 2] != infinity) {
+        distances[state] = distance;
+        buckets[(distance + estimates[state / 2]) % buckets.size()].push_back(state);
+        queued++;
       }
-      for (auto* neighbor : node->neighbors) {
-        if (neighbor->visited) {
+    };
+
+    push(start * 2, 0);
+    push(start * 2 + 1, 0);
+    for (auto priority = estimates[start]; queued != 0; priority++) {
+      auto& bucket = buckets[priority % buckets.size()];
+      while (!bucket.empty()) {
+        const auto state = bucket.back();
+        bucket.pop_back();
+        queued--;
+        const auto block = state / 2;
+        const auto axis = state % 2;
+        const auto distance = distances[state];
+        if (distance + estimates[block] != priority) {
           continue;
         }
-        if (node->value + neighbor->cost < neighbor->value) {
-          neighbor->value = node->value + neighbor->cost;
-          unvisited.push(neighbor);
-        }
-      }
-      node->visited = true;
 
-      if (node->destination) {
-        return node->value;
+        if (block == goal) {
+          return distance;
+        }
+        for (const auto& [r, c] : axes[axis]) {
+          int row = block / width;
+          int col = block % width;
+          uint32_t cost = distance;
+          for (unsigned run = 1; run <= rules.maxRun; run++) {
+            row += r;
+            col += c;
+            if (row < 0 || col < 0 || static_cast<unsigned>(row) >= height || static_cast<unsigned>(col) >= width) {
+              break;
+            }
+            const unsigned next = row * width + col;
+            cost += costs[next];
+            if (run >= rules.minRun) {
+              push(next * 2 + (1 - axis), cost);
+            }
+          }
+        }
       }
     }
 
-    assert(false);
+    return std::numeric_limits<unsigned>::max();
   }
 
-private:
-  std::vector<std::vector<std::vector<Node>>> regular{};
-  std::vector<std::vector<std::vector<Node>>> ultra{};
-
-  bool inside(unsigned row, unsigned col) const {
-    return row < regular.size() && col < regular[row].size();
+  Pos last() const {
+    return {height - 1, width - 1};
   }
 
-  Node& at(Graph& graph, unsigned row, unsigned col, unsigned direction, unsigned line) {
-    return graph[row][col][direction * (graph[row][col].size() / cardinals.size()) + line];
-  }
+private:
+  std::vector<uint8_t> costs{};
+  unsigned width{};
+  unsigned height{};
+  // Goals whose heuristic is kept, each of which costs four bytes per block
+  static constexpr size_t maxHeuristics = 16;
+
+  // Cheapest path from every block to a goal when any block can be entered from any direction, by goal
+  mutable std::map<unsigned, std::vector<uint32_t>> heuristics{};
+
+  // Reverse Dijkstra from the goal, which never overestimates since it ignores the rules
+  const std::vector<uint32_t>& heuristic(unsigned goal) const {
+    if (const auto found = heuristics.find(goal); found != heuristics.end()) {
+      return found->second;
+    }
 
-  void build() {
-    static constexpr std::array nearby{0ull, 1ull, cardinals.size() - 1ull};
-    const auto build = [this](const bool part1) {
-      auto& graph = part1 ? regular : ultra;
-      for (unsigned row = 0; row < graph.size(); row++) {
-        for (unsigned col = 0; col < graph[row].size(); col++) {
-          for (unsigned dir = 0; dir < cardinals.size(); dir++) {
-            for (unsigned line = 0; line < graph[row][col].size() / cardinals.size(); line++) {
-              if (row == graph.size() - 1 && col == graph[row].size() - 1 && (part1 || line > 3)) {
-                at(graph, row, col, dir, line).destination = true;
-              }
-              for (unsigned i = 0; i < nearby.size(); i++) {
-                unsigned d = (dir + nearby[i]) % cardinals.size();
-                const auto& [r, c] = cardinals[d];
-                if (inside(row + r, col + c) && ((part1 && (d != dir || line != 3)) || (!part1 && ((d == dir && line != 10) || (d != dir && line > 3))))) {
-                  at(graph, row, col, dir, line).neighbors.push_back(&at(graph, row + r, col + c, d, dir == d ? line + 1 : 1));
-                }
-              }
-            }
+    if (heuristics.size() == maxHeuristics) {
+      heuristics.erase(heuristics.begin());
+    }
+    auto& result = heuristics[goal];
+    result.assign(costs.size(), std::numeric_limits<uint32_t>::max());
+    std::array<std::vector<uint32_t>, 10> buckets{};
+    size_t queued{1};
+    result[goal] = 0;
+    buckets[0].push_back(goal);
+    for (uint32_t distance = 0; queued != 0; distance++) {
+      auto& bucket = buckets[distance % buckets.size()];
+      while (!bucket.empty()) {
+        const auto block = bucket.back();
+        bucket.pop_back();
+        queued--;
+        if (result[block] != distance) {
+          continue;
+        }
+        const auto estimate = distance + costs[block];
+        for (const auto& direction : axes | std::views::join) {
+          const int row = block / width + direction.first;
+          const int col = block % width + direction.second;
+          if (row < 0 || col < 0 || static_cast<unsigned>(row) >= height || static_cast<unsigned>(col) >= width) {
+            continue;
+          }
+          if (const unsigned next = row * width + col; estimate < result[next]) {
+            result[next] = estimate;
+            buckets[estimate % buckets.size()].push_back(next);
+            queued++;
           }
         }
       }
-    };
-
-    build(true);
-    build(false);
+    }
+    return result;
   }
 };
 
 std::istream& operator>>(std::istream& is, Grid& grid) {
   std::string line{};
   while (is >> line) {
-    grid.regular.push_back({});
-    grid.ultra.push_back({});
+    grid.width = line.size();
+    grid.height++;
     for (const auto c : line) {
-      grid.regular.back().push_back({});
-      grid.ultra.back().push_back({});
-      for (unsigned i = 0; i < 4 * 4; i++) {
-        grid.regular.back().back().push_back(Node(c - '0'));
-      }
-      for (unsigned i = 0; i < 11 * 4; i++) {
-        grid.ultra.back().back().push_back(Node(c - '0'));
-      }
+      grid.costs.push_back(c - '0');
     }
   }
 
-  grid.build();
-
   return is;
 }
 
 int main() {
   Grid grid{};
   std::cin >> grid;
-  std::cout << std::format("Part 1 result = {}\n", grid.path(true));
-  std::cout << std::format("Part 2 result = {}\n", grid.path(false));
+  std::cout << std::format("Part 1 result = {}\n", grid.path(regular, {0, 0}, grid.last(), true));
+  std::cout << std::format("Part 2 result = {}\n", grid.path(ultra, {0, 0}, grid.last(), true));
   return 0;
 }
@@ -5,7 +5,9 @@
 #include <map>
 #include <array>
 #include <cstdint>
-#include <cassert>
+#include <cstdlib>
+#include <algorithm>
+#include <utility>
 
 struct Pos {
   int64_t row{};
@@ -49,63 +51,217 @@ struct Step {
   }
 };
 
-struct Line {
-  Pos start{};
-  int64_t length{};
-  bool down{};
+// Counts lagoon cubes inside rectangles. The outline of the dug cubes (rather than the path through their centers)
+// is a rectilinear polygon R, and the cubes in a rectangle are the area of R inside it. The area of R below and to
+// the left of (y, x) is G(y, x) = sum of w * (x - px) * (y - py) over the points p with px <= x and py <= y, where
+// each edge of R along a column contributes one point per end with opposite weights. A persistent segment tree over
+// the compressed rows, with one version per point in column order, answers each G in O(log n)
+class Lagoon {
+public:
+  explicit Lagoon(const std::vector<Pos>& centers) {
+    std::vector<Pos> path{};
+    for (size_t i = 0; i < centers.size(); i++) {
+      const auto& previous = centers[(i + centers.size() - 1) % centers.size()];
+      const auto& next = centers[(i + 1) % centers.size()];
+      if (unit(previous, centers[i]) != unit(centers[i], next)) {
+        path.push_back(centers[i]);
+      }
+    }
+
+    int64_t orientation{};
+    for (size_t i = 0; i < path.size(); i++) {
+      const auto& next = path[(i + 1) % path.size()];
+      orientation += path[i].col * next.row - next.col * path[i].row;
+    }
+    // Rotating the direction of travel a quarter turn gives the side the outline is on
+    const auto outward = [orientation](const Pos& d) -> Pos {
+      return orientation > 0 ? Pos{-d.col, d.row} : Pos{d.col, -d.row};
+    };
+    std::vector<Pos> outline{};
+    for (size_t i = 0; i < path.size(); i++) {
+      const auto before = outward(unit(path[(i + path.size() - 1) % path.size()], path[i]));
+      const auto after = outward(unit(path[i], path[(i + 1) % path.size()]));
+      outline.push_back({path[i].row + (1 + before.row + after.row) / 2, path[i].col + (1 + before.col + after.col) / 2});
+    }
+
+    std::vector<Point> points{};
+    for (size_t i = 0; i < outline.size(); i++) {
+      const auto& from = outline[i];
+      const auto& to = outline[(i + 1) % outline.size()];
+      if (from.col == to.col) {
+        const int64_t weight = from.row < to.row ? 1 : -1;
+        points.push_back({from.col, std::min(from.row, to.row), weight});
+        points.push_back({from.col, std::max(from.row, to.row), -weight});
+      }
+    }
+    std::ranges::sort(points, {}, &Point::col);
+    if (area(points) < 0) {
+      for (auto& point : points) {
+        point.weight = -point.weight;
+      }
+    }
+
+    for (const auto& point : points) {
+      cols.push_back(point.col);
+      rows.push_back(point.row);
+    }
+    std::ranges::sort(rows);
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+    nodes.push_back({});
+    versions.push_back(0);
+    for (const auto& point : points) {
+      const auto row = std::ranges::lower_bound(rows, point.row) - rows.begin();
+      versions.push_back(insert(versions.back(), 0, rows.size(), row, Sums{point.weight, point.weight * point.col, point.weight * point.row, static_cast<Wide>(point.weight) * point.col * point.row}));
+    }
+  }
+
+  // Number of cubes in the rectangle with corners first and last, both included
+  uint64_t count(const Pos& first, const Pos& last) const {
+    const auto [top, bottom] = std::minmax(first.row, last.row);
+    const auto [left, right] = std::minmax(first.col, last.col);
+    return below(bottom + 1, right + 1) - below(top, right + 1) - below(bottom + 1, left) + below(top, left);
+  }
+
+  // The row with the most cubes and how many it has. Rows only differ where the outline changes
+  std::pair<int64_t, uint64_t> densest() const {
+    std::pair<int64_t, uint64_t> result{};
+    if (cols.empty()) {
+      return result;
+    }
+    for (size_t i = 0; i + 1 < rows.size(); i++) {
+      if (const auto count = this->count({rows[i], cols.front()}, {rows[i], cols.back() - 1}); count > result.second) {
+        result = {rows[i], count};
+      }
+    }
+    return result;
+  }
+
+private:
+  using Wide = __int128;
+
+  struct Point {
+    int64_t col{};
+    int64_t row{};
+    int64_t weight{};
+  };
+
+  struct Sums {
+    int64_t weight{};
+    int64_t col{};
+    int64_t row{};
+    Wide product{};
+
+    Sums& operator+=(const Sums& other) {
+      weight += other.weight;
+      col += other.col;
+      row += other.row;
+      product += other.product;
+      return *this;
+    }
+  };
+
+  struct Node {
+    uint32_t left{};
+    uint32_t right{};
+    Sums sums{};
+  };
+
+  // Sorted columns of the points and the compressed rows
+  std::vector<int64_t> cols{};
+  std::vector<int64_t> rows{};
+  // Node 0 is the empty tree, versions[k] holds the first k points
+  std::vector<Node> nodes{};
+  std::vector<uint32_t> versions{};
+
+  static Pos unit(const Pos& from, const Pos& to) {
+    return {(to.row > from.row) - (to.row < from.row), (to.col > from.col) - (to.col < from.col)};
+  }
 
-  bool overlap(int64_t row) const {
-    if (down) {
-      return row >= start.row && row < start.row + length;
-    } else {
-      return row > start.row - length && row <= start.row;
+  // G beyond every point, which is negative when the weights came out for the opposite orientation
+  static Wide area(const std::vector<Point>& points) {
+    Wide result{};
+    for (const auto& point : points) {
+      result += static_cast<Wide>(point.weight) * point.col * point.row;
     }
+    return result;
+  }
+
+  uint32_t insert(uint32_t node, size_t begin, size_t end, size_t index, const Sums& sums) {
+    auto copy = nodes[node];
+    copy.sums += sums;
+    if (end - begin > 1) {
+      const auto middle = (begin + end) / 2;
+      if (index < middle) {
+        copy.left = insert(copy.left, begin, middle, index, sums);
+      } else {
+        copy.right = insert(copy.right, middle, end, index, sums);
+      }
+    }
+    nodes.push_back(copy);
+    return nodes.size() - 1;
+  }
+
+  // Sums of the points in the rows before index
+  Sums prefix(uint32_t node, size_t begin, size_t end, size_t index) const {
+    Sums result{};
+    while (node != 0 && index > begin) {
+      if (index >= end) {
+        result += nodes[node].sums;
+        break;
+      }
+      const auto middle = (begin + end) / 2;
+      if (index > middle) {
+        result += nodes[nodes[node].left].sums;
+        node = nodes[node].right;
+        begin = middle;
+      } else {
+        node = nodes[node].left;
+        end = middle;
+      }
+    }
+    return result;
+  }
+
+  // Area of the outline above row and left of col
+  int64_t below(int64_t row, int64_t col) const {
+    const auto version = versions[std::ranges::upper_bound(cols, col) - cols.begin()];
+    const auto sums = prefix(version, 0, rows.size(), std::ranges::upper_bound(rows, row) - rows.begin());
+    return static_cast<int64_t>(static_cast<Wide>(col) * row * sums.weight - static_cast<Wide>(col) * sums.row - static_cast<Wide>(row) * sums.col + sums.product);
   }
 };
 
 class Plan {
   friend std::istream& operator>>(std::istream& is, Plan& plan);
 public:
+  // The shoelace formula gives the area A of the polygon through the centers of the dug cubes and Pick's
+  // theorem its interior points I = A - B / 2 + 1, where B is the number of border cubes. The lagoon is I + B
   uint64_t size(const bool part1) const {
-    // Assumes interior is to the left of the lines going down and that the lagoon does not start and end with a line going down
-    static constexpr auto interior = [](const std::vector<Line>& lines) -> uint64_t {
-      uint64_t result{};
-      for (size_t i = 0; i < lines.size(); i++) {
-        const auto& line = lines[i];
-        if (!line.down) {
-          continue;
-        }
-
-        for (int64_t n = lines[i - 1].start.col < line.start.col ? 1 : 0; n < line.length - (lines[i + 1].start.col < line.start.col ? 1 : 0); n++) {
-          const Line* found = nullptr;
-          for (const auto& other : lines) {
-            if (other.overlap(line.start.row + n) && other.start.col < line.start.col && (found == nullptr || other.start.col > found->start.col)) {
-              found = &other;
-            }
-          }
-          assert(found != nullptr);
-          assert(!found->down);
-          result += std::abs(line.start.col - found->start.col) - 1;
-        }
-      }
-
-      return result;
-    };
-    Pos current{0, 0};
-    std::vector<Line> lines{};
+    const auto corners = vertices(part1);
+    int64_t area{};
     uint64_t border{};
+    for (size_t i = 0; i < corners.size(); i++) {
+      const auto& current = corners[i];
+      const auto& next = corners[(i + 1) % corners.size()];
+      area += current.col * next.row - next.col * current.row;
+      border += std::abs(next.row - current.row) + std::abs(next.col - current.col);
+    }
 
+    return (std::abs(area) + border) / 2 + 1;
+  }
+
+  Lagoon lagoon(const bool part1) const {
+    return Lagoon(vertices(part1));
+  }
+
+  std::vector<Pos> vertices(const bool part1) const {
+    Pos current{0, 0};
+    std::vector<Pos> result{};
     for (const auto& step : steps) {
-      const auto dir = directions.at(part1 ? step.dir : step.realDir());
-      const auto count = part1 ? step.count : step.realCount();
-      border += count;
-      if (dir == up || dir == down) {
-        lines.push_back({current, count + 1, dir == down});
-      }
-      current += dir * count;
+      result.push_back(current);
+      current += directions.at(part1 ? step.dir : step.realDir()) * (part1 ? step.count : step.realCount());
     }
-
-    return interior(lines) + border;
+    return result;
   }
 
 private:
@@ -120,10 +276,19 @@ std::istream& operator>>(std::istream& is, Plan& plan) {
   return is;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
   Plan plan{};
   std::cin >> plan;
   std::cout << std::format("Part 1 result = {}\n", plan.size(true));
   std::cout << std::format("Part 2 result = {}\n", plan.size(false));
+  // Queries the part 2 lagoon for the cubes between two corners, given as row and column of each
+  if (argc > 4) {
+    const auto lagoon = plan.lagoon(false);
+    const Pos first{std::stoll(argv[1]), std::stoll(argv[2])};
+    const Pos last{std::stoll(argv[3]), std::stoll(argv[4])};
+    const auto [row, count] = lagoon.densest();
+    std::cout << std::format("Cubes from ({}, {}) to ({}, {}) = {}\n", first.row, first.col, last.row, last.col, lagoon.count(first, last));
+    std::cout << std::format("Densest row = {} with {} cubes\n", row, count);
+  }
   return 0;
 }
@@ -7,8 +7,12 @@
 #include <algorithm>
 #include <ranges>
 #include <utility>
-#include <optional>
-#include <list>
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <limits>
+#include <thread>
+#include <atomic>
 
 std::vector<std::string> tokenize(const std::string& s) {
   std::vector<std::string> tokens{};
@@ -38,10 +42,6 @@ struct Range {
   int64_t count() const {
     return empty() ? 0 : max - min + 1;
   }
-
-  std::pair<Range, Range> split(int64_t v) const {
-    return {v < min ? Range{1, 0} : Range{min, std::min(v, max)}, v > max ? Range{1, 0} : Range{std::max(v, min), max}};
-  }
 };
 
 struct Part {
@@ -80,10 +80,6 @@ struct Part {
     }
   }
 
-  int64_t sum() const {
-    return x.min + m.min + a.min + s.min;
-  }
-
   int64_t combinations() const {
     return x.count() * m.count() * a.count() * s.count();
   }
@@ -104,22 +100,6 @@ struct Rule {
   char op{};
   int64_t val{};
   std::string dest{};
-
-  std::pair<std::optional<Part>, std::optional<Part>> process(const Part& part) const {
-    if (op == '\0') {
-      return {part, {}};
-    }
-    auto [left, right] = part[cat].split(val);
-    left.max -= op == '<' && left.max == val;
-    right.min += op == '>' && right.min == val;
-    auto p1 = part;
-    auto p2 = part;
-    const auto& pass = op == '<' ? left : right;
-    const auto& fail = op == '<' ? right : left;
-    p1[cat] = pass;
-    p2[cat] = fail;
-    return {pass.empty() ? std::nullopt : std::optional{p1}, fail.empty() ? std::nullopt : std::optional{p2}};
-  }
 };
 
 class Workflow {
@@ -140,20 +120,8 @@ public:
     return result;
   }
 
-  auto process(Part part) const {
-    std::vector<std::pair<std::string, Part>> result{};
-    for (const auto& rule : rules) {
-      const auto [pass, fail] = rule.process(part);
-      if (pass) {
-        result.push_back({rule.dest, *pass});
-      }
-      if (fail) {
-        part = *fail;
-      } else {
-        break;
-      }
-    }
-    return result;
+  const std::vector<Rule>& getRules() const {
+    return rules;
   }
 
   const std::string& getName() const {
@@ -164,41 +132,190 @@ private:
   std::vector<Rule> rules{};
 };
 
+// Ratings of many parts, one array per category
+using Ratings = std::array<std::vector<int32_t>, 4>;
+
+// Workflows compiled into one flat program, each workflow being a run of instructions that either
+// jump on a passing comparison or fall through to the next rule. A rule without a condition is
+// compiled to a comparison that always passes, so every instruction is evaluated the same way
+class Program {
+public:
+  static constexpr int32_t accept = -1;
+  static constexpr int32_t reject = -2;
+
+  struct Instruction {
+    uint8_t category{};
+    bool less{};
+    int32_t threshold{};
+    int32_t target{};
+
+    int32_t next(int32_t pc, int32_t rating) const {
+      const bool pass = (less && rating < threshold) || (!less && rating > threshold);
+      return pass ? target : pc + 1;
+    }
+  };
+
+  Program() = default;
+
+  explicit Program(const std::map<std::string, Workflow>& workflows) {
+    std::map<std::string, int32_t> starts{{"A", accept}, {"R", reject}};
+    int32_t size{};
+    for (const auto& [name, workflow] : workflows) {
+      starts[name] = size;
+      size += workflow.getRules().size();
+    }
+    start = starts.at("in");
+    for (const auto& workflow : workflows | std::views::values) {
+      for (const auto& rule : workflow.getRules()) {
+        if (rule.op == '\0') {
+          instructions.push_back({0, true, std::numeric_limits<int32_t>::max(), starts.at(rule.dest)});
+        } else {
+          instructions.push_back({category(rule.cat), rule.op == '<', static_cast<int32_t>(rule.val), starts.at(rule.dest)});
+        }
+      }
+    }
+
+    std::map<std::array<int32_t, 4>, int32_t> unique{};
+    std::vector<int32_t> reduced(instructions.size(), unresolved);
+    root = reduce(start, unique, reduced);
+  }
+
+  bool accepts(const Ratings& ratings, size_t part) const {
+    int32_t pc = start;
+    while (pc >= 0) {
+      const auto& instruction = instructions[pc];
+      pc = instruction.next(pc, ratings[instruction.category][part]);
+    }
+    return pc == accept;
+  }
+
+  // Number of rating combinations in box that are accepted. Results are cached by node and box,
+  // so shared parts of the tree and repeated what-if queries are only counted once
+  uint64_t accepted(const Part& box) const {
+    return accepted(root, box);
+  }
+
+  static uint8_t category(char c) {
+    return std::string_view("xmas").find(c);
+  }
+
+private:
+  static constexpr int32_t unresolved = std::numeric_limits<int32_t>::min();
+
+  // Ratings of category below split go to below, the others to above. Children are nodes or accept and reject
+  struct Node {
+    uint8_t category{};
+    int32_t split{};
+    int32_t below{};
+    int32_t above{};
+  };
+
+  std::vector<Instruction> instructions{};
+  int32_t start{};
+  // The instructions reduced to a decision diagram where unconditional jumps are followed, tests with both
+  // outcomes alike are dropped and identical nodes are shared
+  std::vector<Node> nodes{};
+  int32_t root{};
+  mutable std::map<std::pair<int32_t, std::array<int64_t, 8>>, uint64_t> cache{};
+
+  int32_t reduce(int32_t pc, std::map<std::array<int32_t, 4>, int32_t>& unique, std::vector<int32_t>& reduced) {
+    if (pc < 0) {
+      return pc;
+    }
+    if (reduced[pc] != unresolved) {
+      return reduced[pc];
+    }
+    const auto instruction = instructions[pc];
+    int32_t result{};
+    if (instruction.threshold == std::numeric_limits<int32_t>::max()) {
+      result = reduce(instruction.target, unique, reduced);
+    } else {
+      const auto pass = reduce(instruction.target, unique, reduced);
+      const auto fail = reduce(pc + 1, unique, reduced);
+      const auto split = instruction.less ? instruction.threshold : instruction.threshold + 1;
+      const auto below = instruction.less ? pass : fail;
+      const auto above = instruction.less ? fail : pass;
+      if (below == above) {
+        result = below;
+      } else if (const auto [found, inserted] = unique.try_emplace({instruction.category, split, below, above}, nodes.size()); inserted) {
+        nodes.push_back({instruction.category, split, below, above});
+        result = found->second;
+      } else {
+        result = found->second;
+      }
+    }
+    reduced[pc] = result;
+    return result;
+  }
+
+  uint64_t accepted(int32_t node, const Part& box) const {
+    if (node == reject || box.combinations() == 0) {
+      return 0;
+    }
+    if (node == accept) {
+      return box.combinations();
+    }
+    const std::pair key{node, std::array{box.x.min, box.x.max, box.m.min, box.m.max, box.a.min, box.a.max, box.s.min, box.s.max}};
+    if (const auto found = cache.find(key); found != cache.end()) {
+      return found->second;
+    }
 
+    const auto& [category, split, below, above] = nodes[node];
+    auto low = box;
+    auto high = box;
+    const auto c = "xmas"[category];
+    low[c].max = std::min<int64_t>(low[c].max, split - 1);
+    high[c].min = std::max<int64_t>(high[c].min, split);
+    const auto result = accepted(below, low) + accepted(above, high);
+    cache[key] = result;
+    return result;
+  }
+};
 
 class System {
 friend std::istream& operator>>(std::istream& is, System& system);
 public:
   int64_t process(const bool part1) const {
-    std::vector<Part> accepted{};
-    std::list<std::pair<std::string, Part>> list{};
     if (part1) {
-      for (const auto& part : parts) {
-        list.push_back({"in", part});
-      }
-    } else {
-      list.push_back({"in", {{1, 4000}, {1, 4000}, {1, 4000}, {1, 4000}}});
+      return sumAccepted();
     }
+    return accepted({{1, 4000}, {1, 4000}, {1, 4000}, {1, 4000}});
+  }
 
-    while (!list.empty()) {
-      const auto [name, part] = std::move(list.front());
-      list.pop_front();
-      if (name == "A") {
-        accepted.push_back(part);
-      } else if (name == "R") {
-        continue;
-      } else {
-        for (const auto& next : workflows.at(name).process(part)) {
-          list.push_back(next);
-        }
-      }
-    }
-    return std::ranges::fold_left(accepted | std::views::transform([part1](const Part& part) { return part1 ? part.sum() : part.combinations(); }), 0, std::plus());
+  // Number of rating combinations within box that are accepted
+  uint64_t accepted(const Part& box) const {
+    return program.accepted(box);
   }
 
 private:
   std::map<std::string, Workflow> workflows{};
-  std::vector<Part> parts{};
+  Program program{};
+  Ratings ratings{};
+
+  // One worker per core
+  int64_t sumAccepted() const {
+    static constexpr size_t shard = 4096;
+    const auto shards = (ratings[0].size() + shard - 1) / shard;
+    std::atomic<size_t> next{};
+    std::atomic<int64_t> total{};
+    {
+      std::vector<std::jthread> workers{};
+      for (unsigned i = 0; i < std::max(1u, std::thread::hardware_concurrency()); i++) {
+        workers.emplace_back([&] {
+          int64_t result{};
+          for (size_t index; (index = next++) < shards;) {
+            for (auto part = index * shard; part < std::min(ratings[0].size(), (index + 1) * shard); part++) {
+              if (program.accepts(ratings, part)) {
+                result += ratings[0][part] + ratings[1][part] + ratings[2][part] + ratings[3][part];
+              }
+            }
+          }
+          total += result;
+        });
+      }
+    }
+    return total;
+  }
 };
 
 std::istream& operator>>(std::istream& is, System& system) {
@@ -211,8 +328,13 @@ std::istream& operator>>(std::istream& is, System& system) {
     system.workflows[workflow.getName()] = workflow;
   }
   
+  system.program = Program(system.workflows);
+
   while (std::getline(is, line)) {
-    system.parts.push_back(Part::parse(line));
+    const auto part = Part::parse(line);
+    for (unsigned i = 0; i < system.ratings.size(); i++) {
+      system.ratings[i].push_back(part["xmas"[i]].min);
+    }
   }
   return is;
 }
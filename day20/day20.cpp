@@ -2,135 +2,647 @@
 #include <format>
 #include <vector>
 #include <map>
-#include <list>
 #include <string>
 #include <algorithm>
-#include <functional>
-#include <memory>
 #include <ranges>
 #include <cassert>
 #include <sstream>
 #include <numeric>
+#include <cstdint>
+#include <bit>
+#include <optional>
+#include <utility>
+#include <fstream>
+#include <array>
+#include <limits>
 
-struct Signal {
-  const std::string source{};
-  const std::string dest{};
-  bool pulse{};
+enum class Type : uint8_t {
+  output,
+  broadcast,
+  flipFlop,
+  conjunction,
 };
 
-class Module {
-public:
-  Module(std::vector<std::string> dests) : dests(std::move(dests)) {}
-  virtual void receive(const Signal& signal, const std::function<void(Signal)>& add) = 0;
-  virtual void reset() = 0;
-  virtual ~Module() = default;
+struct Module {
+  Type type{};
+  std::vector<uint32_t> dests{};
+  // Number of modules sending to this one
+  uint32_t inputs{};
+  // First bit of the module's state, one bit for a flip-flop and one per module id for a conjunction
+  size_t offset{};
+};
+
+// A pulse packed as source id, destination id and level
+struct Pulse {
+  static constexpr uint32_t maxModules = 1 << 15;
+
+  static uint32_t pack(uint32_t source, uint32_t dest, bool high) {
+    return source << 17 | dest << 1 | high;
+  }
+
+  static uint32_t source(uint32_t pulse) {
+    return pulse >> 17;
+  }
 
-  const std::vector<std::string>& getDests() const {
-    return dests;
+  static uint32_t dest(uint32_t pulse) {
+    return pulse >> 1 & 0xffff;
   }
 
-  virtual void addSource([[maybe_unused]] const std::string& source) {}
-protected:
-  const std::vector<std::string> dests{};
+  static bool high(uint32_t pulse) {
+    return pulse & 1;
+  }
 };
 
-class FlipFlop : public Module {
+// Ring buffer of pulses that doubles in size on the rare press that outgrows it
+class Queue {
 public:
-  FlipFlop(std::vector<std::string> dests) : Module(std::move(dests)) {}
-  virtual ~FlipFlop() = default;
+  bool empty() const {
+    return head == tail;
+  }
 
-  void receive(const Signal& signal, const std::function<void(Signal)>& add) override {
-    if (signal.pulse) {
-      return;
-    }
-    state = !state;
-    for (const auto& d : dests) {
-      add({signal.dest, d, state});
+  void push(uint32_t pulse) {
+    if (tail - head == buffer.size()) {
+      grow();
     }
+    buffer[tail++ & (buffer.size() - 1)] = pulse;
   }
 
-  void reset() override { 
-    state = false;
+  uint32_t pop() {
+    return buffer[head++ & (buffer.size() - 1)];
   }
+
+  void reserve(size_t size) {
+    while (buffer.size() < size) {
+      grow();
+    }
+  }
+
 private:
-  bool state{};
+  std::vector<uint32_t> buffer{};
+  size_t head{};
+  size_t tail{};
+
+  void grow() {
+    std::vector<uint32_t> larger(std::max<size_t>(buffer.size() * 2, 16));
+    for (size_t i = 0; head + i != tail; i++) {
+      larger[i] = buffer[(head + i) & (buffer.size() - 1)];
+    }
+    tail -= head;
+    head = 0;
+    buffer = std::move(larger);
+  }
 };
 
-class Conjunction : public Module {
+// A trace of consecutive presses, from press 0 before the button is first pressed. After a header of the magic, the
+// number of state words and the snapshot interval, each press has a record of its low and high pulse counts followed
+// by either the whole state, on every interval-th press, or the indices of the state bits it changed as gaps. Counts
+// and gaps are LEB128 varints, everything else is little-endian. A footer holds the file offsets of the snapshots
+constexpr std::array<char, 4> traceMagic{'D', '2', '0', 'T'};
+constexpr std::array<char, 4> traceFooter{'D', '2', '0', 'I'};
+
+struct Press {
+  uint64_t low{};
+  uint64_t high{};
+  std::vector<uint64_t> state{};
+};
+
+class TraceWriter {
 public:
-  Conjunction(std::vector<std::string> dests) : Module(std::move(dests)) {}
-  virtual ~Conjunction() = default;
+  TraceWriter(const std::string& path, size_t words, uint64_t interval) : file(path, std::ios::binary), previous(words), interval(interval) {
+    bytes(traceMagic);
+    fixed(words, 4);
+    fixed(interval, 4);
+  }
 
-  void receive(const Signal& signal, const std::function<void(Signal)>& add) override {
-    memory[signal.source] = signal.pulse;
-    const bool pulse = !std::ranges::all_of(memory | std::views::values, [](const auto p) { return p; });
-    for (const auto& d : dests) {
-      add({signal.dest, d, pulse});
-    }
+  // False once anything failed to reach the file, including opening it
+  bool good() const {
+    return file.good();
   }
 
-  void addSource(const std::string& source) override {
-    memory[source] = false;
+  // Writes the footer and returns whether the whole trace reached the file
+  bool finish() {
+    for (const auto offset : offsets) {
+      fixed(offset, 8);
+    }
+    fixed(presses, 8);
+    fixed(offsets.size(), 8);
+    bytes(traceFooter);
+    flush();
+    file.close();
+    return !file.fail();
   }
 
-  void reset() override { 
-    for (auto& [key, val] : memory) {
-      val = false;
+  void write(const Press& press) {
+    const auto start = written + buffer.size();
+    varint(press.low);
+    varint(press.high);
+    if (presses++ % interval == 0) {
+      offsets.push_back(start);
+      for (const auto word : press.state) {
+        fixed(word, 8);
+      }
+    } else {
+      std::vector<uint64_t> changed{};
+      for (size_t i = 0; i < press.state.size(); i++) {
+        for (auto bits = press.state[i] ^ previous[i]; bits != 0; bits &= bits - 1) {
+          changed.push_back(i * 64 + std::countr_zero(bits));
+        }
+      }
+      varint(changed.size());
+      uint64_t last{};
+      for (const auto bit : changed) {
+        varint(bit - last);
+        last = bit;
+      }
+    }
+    previous = press.state;
+    if (buffer.size() >= 1 << 20) {
+      flush();
     }
   }
+
 private:
-  std::map<std::string, bool> memory{};
+  std::ofstream file;
+  std::vector<char> buffer{};
+  uint64_t written{};
+  std::vector<uint64_t> previous{};
+  uint64_t interval{};
+  uint64_t presses{};
+  std::vector<uint64_t> offsets{};
+
+  void bytes(const std::array<char, 4>& chars) {
+    buffer.insert(buffer.end(), chars.begin(), chars.end());
+  }
+
+  void fixed(uint64_t value, unsigned size) {
+    for (unsigned i = 0; i < size; i++) {
+      buffer.push_back(static_cast<char>(value >> (i * 8)));
+    }
+  }
+
+  void varint(uint64_t value) {
+    for (; value >= 0x80; value >>= 7) {
+      buffer.push_back(static_cast<char>(value | 0x80));
+    }
+    buffer.push_back(static_cast<char>(value));
+  }
+
+  void flush() {
+    file.write(buffer.data(), buffer.size());
+    written += buffer.size();
+    buffer.clear();
+  }
 };
 
-class Broadcast : public Module {
+// Reads any press of a trace by seeking to the snapshot at or before it and replaying at most interval records
+class TraceReader {
 public:
-  Broadcast(std::vector<std::string> dests) : Module(std::move(dests)) {}
-  virtual ~Broadcast() = default;
+  // No reader when the file cannot be read or its header, footer and snapshot offsets do not fit together
+  static std::optional<TraceReader> open(const std::string& path) {
+    TraceReader reader(path);
+    auto& file = reader.file;
+    if (!file.seekg(0, std::ios::end)) {
+      return {};
+    }
+    const uint64_t size = file.tellg();
+    constexpr uint64_t header = 12;
+    constexpr uint64_t footer = 20;
+    if (size < header + footer || !file.seekg(0) || reader.bytes() != traceMagic) {
+      return {};
+    }
+    reader.words = reader.fixed(4);
+    reader.interval = reader.fixed(4);
+    file.seekg(size - footer);
+    reader.presses = reader.fixed(8);
+    const auto snapshots = reader.fixed(8);
+    if (!file || reader.bytes() != traceFooter || reader.interval == 0 || reader.presses == 0) {
+      return {};
+    }
+    // Every interval-th press has a snapshot, which has to end before the offsets do
+    const auto index = size - footer - 8 * snapshots;
+    if (snapshots > (size - header - footer) / 8 || snapshots != (reader.presses - 1) / reader.interval + 1 || reader.words > (index - header) / 8) {
+      return {};
+    }
+    file.seekg(index);
+    reader.offsets.resize(snapshots);
+    for (auto& offset : reader.offsets) {
+      offset = reader.fixed(8);
+      if (offset < header || offset > index - 8 * reader.words) {
+        return {};
+      }
+    }
+    if (!file) {
+      return {};
+    }
+    return reader;
+  }
+
+  uint64_t size() const {
+    return presses;
+  }
 
-  void receive(const Signal& signal, const std::function<void(Signal)>& add) override {
-    for (const auto& d : dests) {
-      add({signal.dest, d, signal.pulse});
+  // No press when its records run past what the file holds
+  std::optional<Press> at(uint64_t press) {
+    assert(press < presses);
+    file.clear();
+    file.seekg(offsets[press / interval]);
+    Press result{varint(), varint(), std::vector<uint64_t>(words)};
+    for (auto& word : result.state) {
+      word = fixed(8);
+    }
+    for (auto i = press / interval * interval; i < press; i++) {
+      result.low = varint();
+      result.high = varint();
+      uint64_t bit{};
+      for (auto changed = varint(); changed != 0 && file; changed--) {
+        bit += varint();
+        if (bit >= words * 64) {
+          return {};
+        }
+        result.state[bit / 64] ^= uint64_t{1} << (bit % 64);
+      }
     }
+    if (!file) {
+      return {};
+    }
+    return result;
   }
 
-  void reset() override { 
+private:
+  std::ifstream file;
+  size_t words{};
+  uint64_t interval{};
+  uint64_t presses{};
+  std::vector<uint64_t> offsets{};
+
+  explicit TraceReader(const std::string& path) : file(path, std::ios::binary) {
+  }
+
+  std::array<char, 4> bytes() {
+    std::array<char, 4> result{};
+    file.read(result.data(), result.size());
+    return result;
+  }
+
+  uint64_t fixed(unsigned size) {
+    uint64_t result{};
+    for (unsigned i = 0; i < size; i++) {
+      result |= static_cast<uint64_t>(static_cast<uint8_t>(file.get())) << (i * 8);
+    }
+    return result;
+  }
+
+  // Stops at the end of the file or after ten bytes, which leaves the stream failed
+  uint64_t varint() {
+    uint64_t result{};
+    for (unsigned shift = 0; shift < 70; shift += 7) {
+      const auto byte = static_cast<uint8_t>(file.get());
+      result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (byte < 0x80 || !file) {
+        return result;
+      }
+    }
+    file.setstate(std::ios::failbit);
+    return result;
   }
 };
 
 class Configuration {
 friend std::istream& operator>>(std::istream& is, Configuration& configuration);
 public:
+  // Part 2 is 0 when rx is not found to get a low pulse, either because it never does or within maxPresses
   uint64_t press(const bool part1) {
-    static constexpr auto hasDest = [](const Module& m, const std::string& dest) { return std::ranges::find(m.getDests(), dest) != m.getDests().end(); };
-    for (auto& [name, module] : modules) {
-      module->reset();
+    if (!part1) {
+      return presses().value_or(0);
     }
+    reset();
     uint64_t lowCount{};
     uint64_t highCount{};
-    std::map<std::string, uint64_t> periods{};
-    std::string penultimate = std::ranges::find_if(modules, [](const auto& pair) { return hasDest(*pair.second, "rx"); })->first;
-    unsigned periodCount = std::ranges::count_if(modules, [&penultimate](const auto& pair) { return hasDest(*pair.second, penultimate); });
-    for (unsigned i = 1; part1 ? i <= 1000 : periods.size() < periodCount; i++) {
-      std::list<Signal> list{{"button", "broadcaster", false}};
-      const auto add = [&list](Signal signal) { list.push_back(std::move(signal)); }; 
-      while (!list.empty()) {
-        const auto signal = std::move(list.front());
-        list.pop_front();
-        if (signal.dest == penultimate && signal.pulse) {
-          periods[signal.source] = i;
+    for (unsigned i = 1; i <= 1000; i++) {
+      pressButton([&](uint32_t pulse) {
+        lowCount += !Pulse::high(pulse);
+        highCount += Pulse::high(pulse);
+      });
+    }
+    return lowCount * highCount;
+  }
+
+  // Writes a trace of presses 0 to count, snapshotting the state every interval presses,
+  // and returns whether the whole trace reached the file
+  bool record(const std::string& path, uint64_t count, uint64_t interval) {
+    reset();
+    TraceWriter writer(path, state.size(), interval);
+    if (!writer.good()) {
+      return false;
+    }
+    writer.write({0, 0, state});
+    for (uint64_t i = 1; i <= count; i++) {
+      Press press{};
+      pressButton([&press](uint32_t pulse) {
+        press.low += !Pulse::high(pulse);
+        press.high += Pulse::high(pulse);
+      });
+      press.state = state;
+      writer.write(press);
+    }
+    return writer.finish();
+  }
+
+  // Puts the modules back into a state read from a trace, unless it was traced from a different network
+  bool restore(const std::vector<uint64_t>& traced) {
+    if (traced.size() != state.size()) {
+      return false;
+    }
+    state = traced;
+    recount();
+    return true;
+  }
+
+  // The flip-flops that are on and the conjunctions that would send a high pulse, by name
+  std::vector<std::string> highModules() const {
+    std::vector<std::string> result{};
+    for (const auto& [name, id] : ids) {
+      const auto& module = modules[id];
+      if (module.type == Type::flipFlop ? test(module.offset) : module.type == Type::conjunction && highs[id] != module.inputs) {
+        result.push_back(name);
+      }
+    }
+    return result;
+  }
+
+  // Fewest presses until rx gets a low pulse, if it ever does. When the only source of rx is a conjunction whose
+  // inputs are each the output of a binary counter, the counters are checked together in the press in which they
+  // all fire. Any other network is simulated as a whole
+  std::optional<uint64_t> presses() {
+    const auto rx = ids.find("rx");
+    if (rx == ids.end()) {
+      return {};
+    }
+    if (const auto counters = decompose(rx->second)) {
+      return aligned(*counters, rx->second);
+    }
+    return simulate(rx->second);
+  }
+
+private:
+  static constexpr uint32_t button = 0;
+  // Presses simulated before giving up on the state ever repeating
+  static constexpr uint64_t maxPresses = 1 << 22;
+
+  // A binary counter recognised by counter(), with chain[i] the flip-flop holding bit i of the count
+  struct Counter {
+    uint32_t output{};
+    uint32_t hub{};
+    uint64_t period{};
+    std::vector<uint32_t> chain{};
+  };
+
+  std::map<std::string, uint32_t> ids{};
+  std::vector<Module> modules{};
+  // Flip-flop states and conjunction memories, laid out by Module::offset
+  std::vector<uint64_t> state{};
+  // Number of high bits in each conjunction's memory
+  std::vector<uint32_t> highs{};
+  Queue queue{};
+
+  uint32_t id(const std::string& name) {
+    if (const auto found = ids.find(name); found != ids.end()) {
+      return found->second;
+    }
+    assert(modules.size() < Pulse::maxModules);
+    ids[name] = modules.size();
+    modules.push_back({});
+    return modules.size() - 1;
+  }
+
+  bool test(size_t bit) const {
+    return state[bit / 64] >> (bit % 64) & 1;
+  }
+
+  void flip(size_t bit) {
+    state[bit / 64] ^= uint64_t{1} << (bit % 64);
+  }
+
+  std::vector<uint32_t> sources(uint32_t dest) const {
+    std::vector<uint32_t> result{};
+    for (uint32_t i = 0; i < modules.size(); i++) {
+      if (std::ranges::find(modules[i].dests, dest) != modules[i].dests.end()) {
+        result.push_back(i);
+      }
+    }
+    return result;
+  }
+
+  bool sendsTo(uint32_t from, uint32_t to) const {
+    return std::ranges::find(modules[from].dests, to) != modules[from].dests.end();
+  }
+
+  // The modules upstream of output, including itself but not the button and broadcaster
+  std::vector<uint32_t> upstream(uint32_t output) const {
+    std::vector<uint32_t> result{output};
+    std::vector<bool> seen(modules.size());
+    seen[output] = true;
+    for (size_t i = 0; i < result.size(); i++) {
+      for (const auto source : sources(result[i])) {
+        if (!seen[source] && modules[source].type != Type::broadcast && source != button) {
+          seen[source] = true;
+          result.push_back(source);
         }
-        if (const auto found = modules.find(signal.dest); found != modules.end()) {
-          found->second->receive(signal, add);
+      }
+    }
+    return result;
+  }
+
+  // The counters feeding the conjunction that is the only source of rx, unless some input is not one
+  std::optional<std::vector<Counter>> decompose(uint32_t rx) const {
+    const auto parents = sources(rx);
+    if (parents.size() != 1 || modules[parents.front()].type != Type::conjunction) {
+      return {};
+    }
+    std::vector<Counter> result{};
+    for (const auto input : sources(parents.front())) {
+      const auto found = counter(input);
+      if (!found) {
+        return {};
+      }
+      result.push_back(*found);
+    }
+    return result;
+  }
+
+  // A counter is a chain of flip-flops started by the broadcaster, with bit i of the count held by the i-th
+  // flip-flop, and a hub conjunction inverted into the output. The flip-flops of the one bits of the period send to
+  // the hub, and once they are all high the hub fires and pulses the zero bits and the first bit, which wraps the
+  // count to zero. The output then fires exactly every period presses
+  std::optional<Counter> counter(uint32_t output) const {
+    const auto hubs = sources(output);
+    if (modules[output].type != Type::conjunction || hubs.size() != 1 || modules[hubs.front()].type != Type::conjunction) {
+      return {};
+    }
+    const auto hub = hubs.front();
+    const auto members = upstream(output);
+    const auto isMember = [&](uint32_t id) { return std::ranges::find(members, id) != members.end(); };
+
+    std::vector<uint32_t> chain{};
+    for (const auto d : modules[ids.at("broadcaster")].dests) {
+      if (isMember(d)) {
+        chain.push_back(d);
+      }
+    }
+    if (chain.size() != 1 || modules[chain.front()].type != Type::flipFlop) {
+      return {};
+    }
+    uint64_t period{};
+    for (size_t bit = 0;; bit++) {
+      const auto current = chain.back();
+      std::optional<uint32_t> next{};
+      for (const auto d : modules[current].dests) {
+        if (d == hub) {
+          continue;
         }
-        lowCount += !signal.pulse;
-        highCount += signal.pulse;
+        if (modules[d].type != Type::flipFlop || next || std::ranges::find(chain, d) != chain.end()) {
+          return {};
+        }
+        next = d;
+      }
+      const bool one = sendsTo(current, hub);
+      if (bit >= 64 || sendsTo(hub, current) != (!one || bit == 0)) {
+        return {};
       }
+      period |= uint64_t{one} << bit;
+      if (!next) {
+        break;
+      }
+      chain.push_back(*next);
+    }
+
+    const auto ones = std::ranges::count_if(chain, [&](uint32_t id) { return sendsTo(id, hub); });
+    if (!sendsTo(chain.front(), hub) || modules[hub].inputs != ones || modules[hub].dests.size() != chain.size() - ones + 2 || !sendsTo(hub, output) || members.size() != chain.size() + 2) {
+      return {};
     }
-    return part1 ? lowCount * highCount : std::ranges::fold_left(periods | std::views::values, 1ull, [](const auto& a, const auto& b) { return std::lcm(a, b); });
+    return Counter{output, hub, period, chain};
   }
 
-private:
-  std::map<std::string, std::unique_ptr<Module>> modules{};
+  // Every counter fires only in the presses that are multiples of its period, so the first press in which they can
+  // all fire together is the least common multiple. Each such press starts from the same state, with every counter
+  // one short of its period, which is built directly and pressed once to see whether rx gets a low pulse in it
+  std::optional<uint64_t> aligned(const std::vector<Counter>& counters, uint32_t rx) {
+    uint64_t multiple{1};
+    for (const auto& counter : counters) {
+      const auto next = static_cast<unsigned __int128>(multiple / std::gcd(multiple, counter.period)) * counter.period;
+      if (next > std::numeric_limits<uint64_t>::max()) {
+        return {};
+      }
+      multiple = next;
+    }
+
+    reset();
+    for (const auto& counter : counters) {
+      for (size_t bit = 0; bit < counter.chain.size(); bit++) {
+        const auto flipFlop = counter.chain[bit];
+        if ((counter.period - 1) >> bit & 1) {
+          flip(modules[flipFlop].offset);
+          if (sendsTo(flipFlop, counter.hub)) {
+            flip(modules[counter.hub].offset + flipFlop);
+          }
+        }
+      }
+      // From the first press on, the last pulse the hub sent is a high one after the count moved on
+      if (multiple > 1) {
+        flip(modules[counter.output].offset + counter.hub);
+      }
+    }
+    recount();
+    bool low{};
+    pressButton([&low, rx](uint32_t pulse) { low |= Pulse::dest(pulse) == rx && !Pulse::high(pulse); });
+    if (!low) {
+      return {};
+    }
+    return multiple;
+  }
+
+  // Presses the button until rx gets a low pulse. The state is compared with the one saved at every power of two
+  // presses, so once it comes back without rx getting a low pulse it never will
+  std::optional<uint64_t> simulate(uint32_t rx) {
+    reset();
+    auto saved = state;
+    for (uint64_t press = 1; press <= maxPresses; press++) {
+      bool low{};
+      pressButton([&low, rx](uint32_t pulse) { low |= Pulse::dest(pulse) == rx && !Pulse::high(pulse); });
+      if (low) {
+        return press;
+      }
+      if (state == saved) {
+        return {};
+      }
+      if (std::has_single_bit(press)) {
+        saved = state;
+      }
+    }
+    return {};
+  }
+
+  // Recomputes the number of high bits in each conjunction's memory from the state
+  void recount() {
+    for (uint32_t id = 0; id < modules.size(); id++) {
+      if (modules[id].type == Type::conjunction) {
+        highs[id] = 0;
+        for (const auto source : sources(id)) {
+          highs[id] += test(modules[id].offset + source);
+        }
+      }
+    }
+  }
+
+  void reset() {
+    std::ranges::fill(state, 0);
+    std::ranges::fill(highs, 0);
+  }
+
+  // Presses the button once and calls observe with every pulse in the order they are delivered
+  template <typename F>
+  void pressButton(const F& observe) {
+    queue.push(Pulse::pack(button, id("broadcaster"), false));
+    while (!queue.empty()) {
+      const auto pulse = queue.pop();
+      observe(pulse);
+      deliver(pulse);
+    }
+  }
+
+  void deliver(uint32_t pulse) {
+    const auto dest = Pulse::dest(pulse);
+    const auto high = Pulse::high(pulse);
+    const auto& module = modules[dest];
+    const auto send = [&](bool level) {
+      for (const auto d : module.dests) {
+        queue.push(Pulse::pack(dest, d, level));
+      }
+    };
+
+    switch (module.type) {
+      case Type::output:
+        break;
+      case Type::broadcast:
+        send(high);
+        break;
+      case Type::flipFlop:
+        if (!high) {
+          flip(module.offset);
+          send(test(module.offset));
+        }
+        break;
+      case Type::conjunction: {
+        const auto bit = module.offset + Pulse::source(pulse);
+        if (test(bit) != high) {
+          flip(bit);
+          highs[dest] += high ? 1 : -1;
+        }
+        send(highs[dest] != module.inputs);
+        break;
+      }
+    }
+  }
 };
 
 std::istream& operator>>(std::istream& is, Configuration& configuration) {
@@ -144,41 +656,104 @@ std::istream& operator>>(std::istream& is, Configuration& configuration) {
     return result;
   };
 
+  configuration.id("button");
   std::string line{};
   while (std::getline(is, line)) {
     std::ranges::replace(line, ',', ' ');
     const auto tokens = split(std::move(line));
-    std::vector<std::string> dests{};
-    dests.insert(dests.end(), tokens.begin() + 2, tokens.end());
+    Type type{};
     switch (tokens[0][0]) {
       case '%':
-        configuration.modules[tokens[0].substr(1)] = std::make_unique<FlipFlop>(std::move(dests));
+        type = Type::flipFlop;
         break;
       case '&':
-        configuration.modules[tokens[0].substr(1)] = std::make_unique<Conjunction>(std::move(dests));
+        type = Type::conjunction;
         break;
       case 'b':
-        configuration.modules[tokens[0]] = std::make_unique<Broadcast>(std::move(dests));
+        type = Type::broadcast;
         break;
       default:
         assert(false);
     }
+    const auto id = configuration.id(type == Type::broadcast ? tokens[0] : tokens[0].substr(1));
+    configuration.modules[id].type = type;
+    for (const auto& d : tokens | std::views::drop(2)) {
+      // Interning may grow modules, so the id is looked up before indexing
+      const auto dest = configuration.id(d);
+      configuration.modules[id].dests.push_back(dest);
+    }
   }
+  configuration.modules[configuration.id("button")].dests = {configuration.id("broadcaster")};
 
-  for (const auto& [key, val] : configuration.modules) {
-    for (const auto& d : val->getDests()) {
-      if (const auto found = configuration.modules.find(d); found != configuration.modules.end()) {
-        found->second->addSource(key);
-      }
+  size_t bits{};
+  size_t edges{};
+  for (auto& module : configuration.modules) {
+    for (const auto d : module.dests) {
+      configuration.modules[d].inputs++;
     }
+    edges += module.dests.size();
+  }
+  for (auto& module : configuration.modules) {
+    module.offset = bits;
+    bits += module.type == Type::flipFlop ? 1 : module.type == Type::conjunction ? configuration.modules.size() : 0;
   }
+  configuration.state.assign((bits + 63) / 64, 0);
+  configuration.highs.assign(configuration.modules.size(), 0);
+  configuration.queue.reserve(std::bit_ceil(edges + 1));
   return is;
 }
 
-int main() {
+// With "record <trace> <presses> [interval]" the presses are also traced to a file, and with
+// "inspect <trace> <press>" the state after a traced press is printed instead of the results
+int main(int argc, char* argv[]) {
+  const std::string mode = argc > 1 ? argv[1] : "";
+  if (!mode.empty() && !(mode == "inspect" && argc == 4) && !(mode == "record" && (argc == 4 || argc == 5))) {
+    std::cerr << "Usage: day20 [record <trace> <presses> [interval] | inspect <trace> <press>] < input\n";
+    return 1;
+  }
   Configuration configuration{};
   std::cin >> configuration;
+  if (mode == "inspect") {
+    auto reader = TraceReader::open(argv[2]);
+    if (!reader) {
+      std::cerr << std::format("{} is not a readable trace\n", argv[2]);
+      return 1;
+    }
+    const auto press = std::stoull(argv[3]);
+    if (press >= reader->size()) {
+      std::cerr << std::format("The trace only holds presses 0 to {}\n", reader->size() - 1);
+      return 1;
+    }
+    const auto traced = reader->at(press);
+    if (!traced) {
+      std::cerr << std::format("{} is cut short before press {}\n", argv[2], press);
+      return 1;
+    }
+    if (!configuration.restore(traced->state)) {
+      std::cerr << "The trace was recorded from a different network\n";
+      return 1;
+    }
+    std::cout << std::format("Press {} sent {} low and {} high pulses\n", press, traced->low, traced->high);
+    for (const auto& name : configuration.highModules()) {
+      std::cout << std::format("{} is high\n", name);
+    }
+    return 0;
+  }
+
+  const auto interval = argc > 4 ? std::stoull(argv[4]) : 1000;
+  if (interval == 0) {
+    std::cerr << "The snapshot interval must be at least 1\n";
+    return 1;
+  }
   std::cout << std::format("Part 1 result = {}\n", configuration.press(true));
   std::cout << std::format("Part 2 result = {}\n", configuration.press(false));
+  if (mode == "record") {
+    const auto presses = std::stoull(argv[3]);
+    if (!configuration.record(argv[2], presses, interval)) {
+      std::cerr << std::format("Could not write the trace to {}\n", argv[2]);
+      return 1;
+    }
+    std::cout << std::format("Traced {} presses to {}\n", presses, argv[2]);
+  }
   return 0;
 }
@@ -2,7 +2,13 @@
 #include <format>
 #include <vector>
 #include <string>
-#include <unordered_set>
+#include <optional>
+#include <limits>
+#include <algorithm>
+#include <thread>
+#include <barrier>
+#include <bit>
+#include <ranges>
 #include <utility>
 #include <array>
 #include <cstdint>
@@ -28,97 +34,217 @@ constexpr Pos south{1, 0};
 constexpr Pos west{0, -1};
 constexpr std::array cardinals{north, east, south, west};
 
+// Counts can be far beyond 64 bits for step counts near 10^18
+using Count = unsigned __int128;
+
+std::string toString(Count count) {
+  std::string result{};
+  do {
+    result.insert(result.begin(), static_cast<char>('0' + count % 10));
+    count /= 10;
+  } while (count != 0);
+  return result;
+}
+
 class Garden {
 friend std::istream& operator>>(std::istream& is, Garden& garden);
 public:
-  uint64_t walk(uint64_t n) const {
-    const auto findPattern = [](const std::vector<uint64_t>& values) -> std::vector<std::pair<uint64_t, uint64_t>> {
-      std::vector<std::pair<uint64_t, uint64_t>> result{};
-      const auto valid = [&values](const uint64_t period) -> bool {
-        const auto diff = values[values.size() - 1] - values[values.size() - period - 1];
-        for (unsigned i = 1; i < 6; i++) {
-          if (values.back() - diff * i != values[values.size() - 1 - i * period]) {
-            return false;
-          }
-        }
-        return true;
-      };
-      for (uint64_t i = 1;; i++) {
-        if (valid(i)) {
-          for (uint64_t j = 0; j < i; j++) {
-            uint64_t current = values.size() - i + j;
-            uint64_t prev = values.size() - i * 2 + j;
-            result.push_back({values[current], values[current] - values[prev]});
-          }
-          return result;
+  // Number of plots reachable in exactly n steps, which are the plots at a distance of at most n with the parity of n.
+  // Distances come from one BFS over a block of (2k + 1) x (2k + 1) copies of the garden around the start, and are
+  // exact up to the first distance that reaches the edge of the block. Beyond it the number of plots at each distance
+  // must have settled into growing by the same amounts every period, which is checked over the last three periods
+  // seen, and the sum is taken in closed form. The block is doubled until that happens. If it never does within
+  // maxCells the steps are simulated when the region they reach fits in maxSimulatedSide, or else there is no result
+  std::optional<Count> walk(uint64_t n) const {
+    for (unsigned k = 1; static_cast<uint64_t>(2 * k + 1) * (2 * k + 1) * width * height <= maxCells; k *= 2) {
+      const auto [counts, complete] = distances(k);
+      if (n < counts.size() || complete) {
+        Count result{};
+        for (uint64_t d = n % 2; d < counts.size() && d <= n; d += 2) {
+          result += counts[d];
         }
+        return result;
       }
-      assert(false);
-    };
-    uint64_t count{};
-    const bool odd = n % 2 != 0;
-
-    constexpr auto hash = [](const Pos& p) { return p.row + p.col * 97; };
-    std::unordered_set<Pos, decltype(hash)> current{start};
-    std::unordered_set<Pos, decltype(hash)> next{};
-    std::unordered_set<Pos, decltype(hash)> prev{};
-    std::vector<uint64_t> increments{};
-
-    // Assumes pattern found after 1000 steps
-    uint64_t i{};
-    for (; i <= std::min(n + 1, static_cast<uint64_t>(1000)); i++) {
-      increments.push_back(current.size());
-      for (const auto& pos : current) {
-        count += i % 2 == odd;
-        for (const auto& dir : cardinals) {
-          if (const auto p = pos + dir; !prev.contains(p) && at(p) != '#') {
-            next.insert(p);
-          }
-        }
+      if (const auto result = extrapolate(counts, n)) {
+        return result;
       }
-      prev = std::move(current);
-      current = std::move(next);
     }
+    if (n <= (maxSimulatedSide - 1) / 2) {
+      return simulate(n);
+    }
+    return {};
+  }
 
-    if (i >= n) {
-      return count;
+  // Steps every plot reachable so far at once on the (2n + 1) x (2n + 1) region around the start, one bit per plot.
+  // A step is (left | right | above | below) & ~rocks on each row, only over the diamond reachable by then, with the
+  // rows shared out between one worker per core
+  uint64_t simulate(uint64_t n) const {
+    const size_t size = 2 * n + 1;
+    const size_t words = (size + 63) / 64;
+    // Rows of the region only depend on the garden row, and the bits past the region count as rocks
+    std::vector<uint64_t> rocks(height * words);
+    const auto firstRow = ((start.row - static_cast<int64_t>(n)) % height + height) % height;
+    const auto firstCol = ((start.col - static_cast<int64_t>(n)) % width + width) % width;
+    for (unsigned row = 0; row < height; row++) {
+      for (size_t col = 0; col < words * 64; col++) {
+        if (col >= size || grid[(firstRow + row) % height * width + (firstCol + col) % width] == '#') {
+          rocks[row * words + col / 64] |= uint64_t{1} << (col % 64);
+        }
+      }
     }
 
-    auto pattern = findPattern(increments);
-    for (uint64_t j = 0; i <= n; j++, i++) {
-      auto& [inc, diff] = pattern[j % pattern.size()];
-      inc += diff;
-      if (i % 2 == odd) {
-        count += inc;
+    std::array<std::vector<uint64_t>, 2> buffers{std::vector<uint64_t>(size * words), std::vector<uint64_t>(size * words)};
+    buffers[0][n * words + n / 64] = uint64_t{1} << (n % 64);
+    const unsigned workerCount = std::max(1u, std::thread::hardware_concurrency());
+    std::barrier sync(workerCount);
+    {
+      std::vector<std::jthread> workers{};
+      for (unsigned worker = 0; worker < workerCount; worker++) {
+        workers.emplace_back([&, worker] {
+          for (uint64_t step = 1; step <= n; step++) {
+            const auto& current = buffers[(step - 1) % 2];
+            auto& next = buffers[step % 2];
+            for (auto row = n - step + worker; row <= n + step; row += workerCount) {
+              const auto reach = step - (row > n ? row - n : n - row);
+              const auto first = (n - reach) / 64;
+              const auto last = (n + reach) / 64;
+              const auto* above = row > 0 ? &current[(row - 1) * words] : nullptr;
+              const auto* below = row + 1 < size ? &current[(row + 1) * words] : nullptr;
+              const auto* middle = &current[row * words];
+              const auto* rock = &rocks[row % height * words];
+              for (auto word = first; word <= last; word++) {
+                auto bits = middle[word] << 1 | middle[word] >> 1;
+                bits |= word > 0 ? middle[word - 1] >> 63 : 0;
+                bits |= word + 1 < words ? middle[word + 1] << 63 : 0;
+                bits |= above ? above[word] : 0;
+                bits |= below ? below[word] : 0;
+                next[row * words + word] = bits & ~rock[word];
+              }
+            }
+            sync.arrive_and_wait();
+          }
+        });
       }
     }
-    
-    return count;
+
+    return std::ranges::fold_left(buffers[n % 2] | std::views::transform([](const auto word) { return std::popcount(word); }), uint64_t{}, std::plus());
   }
 
 private:
-  std::vector<std::vector<char>> grid{};
+  static constexpr uint64_t maxCells = 1 << 24;
+  // Simulated regions are at most this many plots on a side, which is 128 MiB per buffer
+  static constexpr uint64_t maxSimulatedSide = 1 << 15;
+  static constexpr auto unreached = std::numeric_limits<uint32_t>::max();
+
+  std::vector<char> grid{};
+  unsigned width{};
+  unsigned height{};
   Pos start{};
 
-  char at(const Pos& pos) const {
-    int size = grid.size();
-    const auto row = (pos.row % size + size) % size;
-    size = grid[row].size();
-    const auto col = (pos.col % size + size) % size;
-    return grid[row][col];
+  struct Distances {
+    // The number of plots at each distance from the start, up to the first distance at which the edge of the block
+    // is reached
+    std::vector<uint64_t> counts{};
+    // Whether the edge is never reached, so that counts holds every plot that can be reached at all
+    bool complete{};
+  };
+
+  Distances distances(unsigned k) const {
+    const unsigned blockWidth = (2 * k + 1) * width;
+    const unsigned blockHeight = (2 * k + 1) * height;
+    std::vector<uint32_t> field(static_cast<size_t>(blockWidth) * blockHeight, unreached);
+    std::vector<uint32_t> queue{};
+    queue.reserve(field.size());
+    const auto first = (k * height + start.row) * blockWidth + k * width + start.col;
+    field[first] = 0;
+    queue.push_back(first);
+
+    std::vector<uint64_t> counts{};
+    uint32_t limit{unreached};
+    for (size_t i = 0; i < queue.size(); i++) {
+      const auto index = queue[i];
+      const auto distance = field[index];
+      if (distance >= limit) {
+        break;
+      }
+      if (distance == counts.size()) {
+        counts.push_back(0);
+      }
+      counts.back()++;
+
+      const unsigned row = index / blockWidth;
+      const unsigned col = index % blockWidth;
+      if (row == 0 || col == 0 || row == blockHeight - 1 || col == blockWidth - 1) {
+        limit = std::min(limit, distance + 1);
+      }
+      for (const auto& dir : cardinals) {
+        const auto r = row + dir.row;
+        const auto c = col + dir.col;
+        if (r >= blockHeight || c >= blockWidth) {
+          continue;
+        }
+        const auto next = r * blockWidth + c;
+        if (field[next] == unreached && grid[r % height * width + c % width] != '#') {
+          field[next] = distance + 1;
+          queue.push_back(next);
+        }
+      }
+    }
+    counts.resize(std::min<size_t>(counts.size(), limit));
+    return {counts, limit == unreached};
+  }
+
+  // With period p and base b, the plots at distance b + j + m * p for j < p number counts[b + j] + m * delta[j]
+  static std::optional<Count> extrapolate(const std::vector<uint64_t>& counts, uint64_t n) {
+    using Wide = __int128;
+    const auto size = counts.size();
+    const auto settled = [&counts, size](uint64_t period) {
+      for (auto d = size - 3 * period; d < size; d++) {
+        if (counts[d] + counts[d - 2 * period] != 2 * counts[d - period]) {
+          return false;
+        }
+      }
+      return true;
+    };
+
+    for (uint64_t period = 1; 5 * period <= size; period++) {
+      if (!settled(period)) {
+        continue;
+      }
+      const auto base = size - period;
+      Wide result{};
+      for (auto d = n % 2; d < base; d += 2) {
+        result += counts[d];
+      }
+      for (uint64_t j = 0; j < period; j++) {
+        const Wide count = counts[base + j];
+        const Wide delta = count - static_cast<Wide>(counts[base + j - period]);
+        const Wide last = (n - base - j) / period;
+        if (period % 2 == 0) {
+          if ((base + j) % 2 == n % 2) {
+            result += (last + 1) * count + delta * last * (last + 1) / 2;
+          }
+        } else if (const Wide first = (n - base - j) % 2; first <= last) {
+          // Every other m has the parity of n
+          const Wide terms = (last - first) / 2;
+          result += (terms + 1) * (count + delta * first) + delta * terms * (terms + 1);
+        }
+      }
+      return static_cast<Count>(result);
+    }
+    return {};
   }
 };
 
 std::istream& operator>>(std::istream& is, Garden& garden) {
   std::string line{};
   while (is >> line) {
-    garden.grid.push_back({});
-    for (const auto c : line) {
-      garden.grid.back().push_back(c);
-      if (c == 'S') {
-        garden.start = Pos(garden.grid.size() - 1, garden.grid.back().size() -1);
-      }
+    if (const auto found = line.find('S'); found != std::string::npos) {
+      garden.start = {static_cast<int>(garden.height), static_cast<int>(found)};
     }
+    garden.width = line.size();
+    garden.height++;
+    garden.grid.insert(garden.grid.end(), line.begin(), line.end());
   }
   return is;
 }
@@ -126,7 +252,14 @@ std::istream& operator>>(std::istream& is, Garden& garden) {
 int main() {
   Garden garden{};
   std::cin >> garden;
-  std::cout << std::format("Part 1 result = {}\n", garden.walk(64));
-  std::cout << std::format("Part 2 result = {}\n", garden.walk(26501365));
+  const auto print = [&garden](unsigned part, uint64_t steps) {
+    if (const auto result = garden.walk(steps)) {
+      std::cout << std::format("Part {} result = {}\n", part, toString(*result));
+    } else {
+      std::cerr << std::format("Part {}: the plots reached do not settle into a repeating pattern\n", part);
+    }
+  };
+  print(1, 64);
+  print(2, 26501365);
   return 0;
 }
@@ -2,9 +2,10 @@
 #include <format>
 #include <vector>
 #include <string>
-#include <list>
-#include <set>
-#include <map>
+#include <limits>
+#include <bit>
+#include <cstdint>
+#include <utility>
 #include <algorithm>
 
 struct Brick {
@@ -14,77 +15,114 @@ struct Brick {
   unsigned maxX{};
   unsigned maxY{};
   unsigned maxZ{};
-
-  void fall() {
-    minZ--;
-    maxZ--;
-  }
-
-  bool supports(const Brick& other) const {
-    return other.minZ == maxZ + 1 && !(other.minX > maxX || other.maxX < minX || other.minY > maxY || other.maxY < minY);
-  }
 };
 
 class Sand {
 friend std::istream& operator>>(std::istream& is, Sand& sand);
 public:
+  // Bricks are dropped lowest first, each straight onto the highest point under its footprint in a height map of the
+  // x-y plane. The bricks it lands on are the ones on top at that height, which gives the support graph for free
   unsigned settle() {
-    std::list<Brick*> list{};
+    std::ranges::sort(bricks, {}, &Brick::minZ);
+    unsigned width{};
+    unsigned depth{};
+    for (const auto& brick : bricks) {
+      width = std::max(width, brick.maxX + 1);
+      depth = std::max(depth, brick.maxY + 1);
+    }
+    std::vector<unsigned> heights(width * depth);
+    std::vector<unsigned> tops(width * depth, none);
+    supporters.assign(bricks.size(), {});
+    supported.assign(bricks.size(), {});
+
     unsigned count{};
-    for (unsigned z = 1; list.size() < bricks.size(); z++) {
-      for (auto& brick : bricks) {
-        if (brick.maxZ == z) {
-          list.push_back(&brick);
+    for (unsigned id = 0; id < bricks.size(); id++) {
+      auto& brick = bricks[id];
+      unsigned floor{};
+      for (unsigned y = brick.minY; y <= brick.maxY; y++) {
+        for (unsigned x = brick.minX; x <= brick.maxX; x++) {
+          floor = std::max(floor, heights[y * width + x]);
         }
       }
-    }
-
-    while (!list.empty()) {
-      auto* brick = list.front();
-      list.pop_front();
-      bool falling{};
-      while (brick->minZ > 1 && std::ranges::none_of(bricks, [brick](const auto& b) { return b.supports(*brick); })) {
-        falling = true;
-        brick->fall();
+      for (unsigned y = brick.minY; y <= brick.maxY; y++) {
+        for (unsigned x = brick.minX; x <= brick.maxX; x++) {
+          const auto cell = y * width + x;
+          if (const auto top = tops[cell]; heights[cell] == floor && top != none && std::ranges::find(supporters[id], top) == supporters[id].end()) {
+            supporters[id].push_back(top);
+            supported[top].push_back(id);
+          }
+          heights[cell] = floor + 1 + brick.maxZ - brick.minZ;
+          tops[cell] = id;
+        }
       }
-      count += falling;
+      count += brick.minZ != floor + 1;
+      brick.maxZ -= brick.minZ - floor - 1;
+      brick.minZ = floor + 1;
     }
     return count;
   }
 
+  // A brick can go if everything it supports has another supporter
   unsigned part1() const {
-    std::set<const Brick*> candidates{};
-    std::map<const Brick*, std::set<const Brick*>> support{};
+    return std::ranges::count_if(supported, [this](const auto& above) { return std::ranges::all_of(above, [this](unsigned id) { return supporters[id].size() > 1; }); });
+  }
 
-    for (const auto& b1 : bricks) {
-      candidates.insert(&b1);
-      for (const auto& b2 : bricks) {
-        if (b2.supports(b1)) {
-          support[&b1].insert(&b2);
+  // With the ground as the root of the support graph, removing a brick makes exactly the bricks it dominates fall,
+  // because every path from the ground to them passes through it. Bricks are settled in topological order, so the
+  // immediate dominator of each is the lowest common ancestor of its supporters in the tree built so far, found by
+  // binary lifting. A brick's chain reaction is its subtree in the dominator tree, less itself
+  uint64_t part2() const {
+    const unsigned ground = bricks.size();
+    const unsigned levels = std::bit_width(bricks.size() + 1);
+    // ancestors[j][i] is the 2^j-th dominator above brick i
+    std::vector<std::vector<unsigned>> ancestors(levels, std::vector<unsigned>(bricks.size() + 1, ground));
+    std::vector<unsigned> depths(bricks.size() + 1);
+    const auto common = [&](unsigned a, unsigned b) {
+      if (depths[a] < depths[b]) {
+        std::swap(a, b);
+      }
+      for (unsigned j = levels; j-- > 0;) {
+        if (depths[a] - depths[b] >= 1u << j) {
+          a = ancestors[j][a];
         }
       }
-    }
+      for (unsigned j = levels; j-- > 0 && a != b;) {
+        if (ancestors[j][a] != ancestors[j][b]) {
+          a = ancestors[j][a];
+          b = ancestors[j][b];
+        }
+      }
+      return a == b ? a : ancestors[0][a];
+    };
 
-    for (const auto& [supported, supports] : support) {
-      if (supports.size() == 1) {
-        candidates.erase(*supports.begin());
+    for (unsigned id = 0; id < bricks.size(); id++) {
+      auto dominator = supporters[id].empty() ? ground : supporters[id].front();
+      for (const auto supporter : supporters[id]) {
+        dominator = common(dominator, supporter);
+      }
+      ancestors[0][id] = dominator;
+      depths[id] = depths[dominator] + 1;
+      for (unsigned j = 1; j < levels; j++) {
+        ancestors[j][id] = ancestors[j - 1][ancestors[j - 1][id]];
       }
     }
-    return candidates.size();
-  }
 
-  unsigned part2() const {
-    unsigned count{};
-    for (size_t i = 0; i < bricks.size(); i++) {
-      Sand copy = *this;
-      copy.bricks.erase(copy.bricks.begin() + i);
-      count += copy.settle();
+    std::vector<uint64_t> sizes(bricks.size() + 1, 1);
+    uint64_t result{};
+    for (auto id = bricks.size(); id-- > 0;) {
+      sizes[ancestors[0][id]] += sizes[id];
+      result += sizes[id] - 1;
     }
-    return count;
+    return result;
   }
 
 private:
+  static constexpr unsigned none = std::numeric_limits<unsigned>::max();
+
   std::vector<Brick> bricks{};
+  // The bricks each brick rests on and the bricks resting on it, by index into bricks once settled
+  std::vector<std::vector<unsigned>> supporters{};
+  std::vector<std::vector<unsigned>> supported{};
 };
 
 std::istream& operator>>(std::istream& is, Sand& sand) {